@@ -0,0 +1,145 @@
+#include "AluBenchmark.h"
+#include "DevCore.h"
+#include "Jit.h"
+#include "Opcodes.h"
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    constexpr uint16_t kLoopStart = 0x0150;
+
+    // Register-only flag producers and consumers; (HL) and SP forms would
+    // send the loop's stores anywhere
+    bool IsFlagOp(const char* mnemonic)
+    {
+        const std::string_view name = mnemonic;
+        if (name.find("(HL") != std::string_view::npos || name.find("SP") != std::string_view::npos)
+            return name == "LD HL,SP+r8";
+        for (const char* op : { "ADD", "ADC", "SUB", "SBC", "AND", "XOR", "OR", "CP", "INC", "DEC",
+                                "DAA", "CPL", "SCF", "CCF", "RLCA", "RRCA", "RLA", "RRA" })
+            if (name.starts_with(op))
+                return true;
+        // Fresh operands now and then
+        return name.starts_with("LD ") && name.ends_with(",d8");
+    }
+
+    // 32 KB image: LD SP into WRAM, then a loop of flag operations, CB
+    // rotates/shifts/BIT, PUSH/POP AF and JR cc over one-byte operations
+    std::vector<uint8_t> GenerateProgram(uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> image(0x8000, 0);
+        uint16_t pc = 0x0100;
+        const uint8_t entry[] = { 0x31, 0xF0, 0xDF, 0xC3, kLoopStart & 0xFF, kLoopStart >> 8 }; // LD SP,DFF0; JP loop
+        for (uint8_t byte : entry)
+            image[pc++] = byte;
+
+        auto emitFlagOp = [&](bool oneByte) {
+            for (;;)
+            {
+                const uint8_t opcode = static_cast<uint8_t>(rng());
+                if (!IsFlagOp(kOpcodeTable[opcode].mnemonic) || (oneByte && kOpcodeTable[opcode].length != 1))
+                    continue;
+                image[pc++] = opcode;
+                for (int i = 1; i < kOpcodeTable[opcode].length; i++)
+                    image[pc++] = static_cast<uint8_t>(rng());
+                return;
+            }
+        };
+
+        pc = kLoopStart;
+        for (int i = 0; i < 96; i++)
+        {
+            switch (rng() % 8)
+            {
+            case 0:
+                // RLC..SRL and BIT on a register
+                for (;;)
+                {
+                    const uint8_t cb = static_cast<uint8_t>(rng() % 0x80);
+                    if ((cb & 7) == 6)
+                        continue;
+                    image[pc++] = 0xCB;
+                    image[pc++] = cb;
+                    break;
+                }
+                break;
+            case 1:
+                image[pc++] = 0xF5; // PUSH AF
+                emitFlagOp(false);
+                image[pc++] = 0xF1; // POP AF
+                break;
+            case 2:
+                image[pc++] = static_cast<uint8_t>(0x20 | (rng() % 4) << 3); // JR NZ/Z/NC/C,+1
+                image[pc++] = 0x01;
+                emitFlagOp(true);
+                break;
+            default:
+                emitFlagOp(false);
+                break;
+            }
+        }
+        image[pc++] = 0xC3; // JP loop
+        image[pc++] = kLoopStart & 0xFF;
+        image[pc++] = kLoopStart >> 8;
+        return image;
+    }
+
+    double EmulatedMHz(const std::vector<uint8_t>& image, uint32_t frames, ExecutionMode mode)
+    {
+        auto emulator = MakeScratchCore(image, mode);
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++)
+            emulator->RunFrame();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return frames * double(Emulator::kCyclesPerFrame) / std::chrono::duration<double, std::micro>(elapsed).count();
+    }
+}
+
+// Befriended by CPU to reach MaterializeFlags
+class FlagCheck
+{
+public:
+    static bool Run(uint32_t programs, uint32_t instructions)
+    {
+        for (uint32_t seed = 0; seed < programs; seed++)
+        {
+            const std::vector<uint8_t> image = GenerateProgram(seed);
+            auto lazy = MakeScratchCore(image, ExecutionMode::Interpreter);
+            auto eager = MakeScratchCore(image, ExecutionMode::Interpreter);
+            CPU& a = lazy->GetCPU();
+            CPU& b = eager->GetCPU();
+            for (uint32_t i = 0; i < instructions; i++)
+            {
+                a.Step();
+                b.Step();
+                b.MaterializeFlags();
+                const CPU::Registers x = a.GetRegisters();
+                const CPU::Registers y = b.GetRegisters();
+                if (x.AF != y.AF || x.BC != y.BC || x.DE != y.DE || x.HL != y.HL || x.SP != y.SP || x.PC != y.PC)
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+AluBenchmarkResult RunAluBenchmark(uint32_t frames)
+{
+    const std::vector<uint8_t> image = GenerateProgram(0);
+    AluBenchmarkResult result;
+    result.interpreter = EmulatedMHz(image, frames, ExecutionMode::Interpreter);
+    result.blockCache = EmulatedMHz(image, frames, ExecutionMode::BlockCache);
+    if (Jit::IsSupported())
+        result.jit = EmulatedMHz(image, frames, ExecutionMode::Jit);
+    return result;
+}
+
+bool CheckLazyFlags(uint32_t programs, uint32_t instructions)
+{
+    return FlagCheck::Run(programs, instructions);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// Dev-only benchmark of flag-heavy code: a loop of 8-bit arithmetic, logic,
+// rotates, DAA, PUSH/POP AF and conditional branches, generated with a fixed
+// seed, run on a private Emulator once per execution mode. This is the code
+// the lazy flags (CPU::FlagOp) are meant to speed up.
+struct AluBenchmarkResult
+{
+    // Emulated MHz (millions of cycles per host second); 0 when the mode is
+    // not available
+    double interpreter = 0;
+    double blockCache = 0;
+    double jit = 0;
+};
+
+AluBenchmarkResult RunAluBenchmark(uint32_t frames = 600);
+
+// The same kind of program (one per seed) run on two interpreters, one with
+// lazy flags and one with the flags materialized after every instruction,
+// which is what a GBEMU_EAGER_FLAGS build does. F and the other registers
+// must agree after every instruction. True when they always did.
+bool CheckLazyFlags(uint32_t programs = 32, uint32_t instructions = 200000);
@@ -0,0 +1,168 @@
+#include "BlockCache.h"
+#include "MMU.h"
+#include "Jit.h"
+#include "Opcodes.h"
+
+// Code regions a block may not straddle; anything outside them is interpreted
+static bool CodeRegion(uint16_t addr, uint16_t& regionEnd)
+{
+    if (addr <= 0x3FFF) { regionEnd = 0x3FFF; return true; } // ROM bank 0
+    if (addr <= 0x7FFF) { regionEnd = 0x7FFF; return true; } // switchable ROM bank
+    if (addr >= 0xC000 && addr <= 0xDFFF) { regionEnd = 0xDFFF; return true; } // WRAM
+    if (addr >= 0xFF80 && addr <= 0xFFFE) { regionEnd = 0xFFFE; return true; } // HRAM
+    return false;
+}
+
+BlockCache::BlockCache(MMU* mmu, const Handler* handlers)
+    : mmu(mmu), handlers(handlers), fastLookup(0x10000, nullptr)
+{
+    mmu->SetBlockCache(this);
+    OnBankSwitch();
+}
+
+BlockCache::~BlockCache()
+{
+    Clear();
+    mmu->SetBlockCache(nullptr);
+}
+
+void BlockCache::OnBankSwitch()
+{
+    bank0 = mmu->GetROMBank(0x0000);
+    bankX = mmu->GetROMBank(0x4000);
+    dmaActive = mmu->IsOamDmaActive();
+    epoch++;
+}
+
+Block* BlockCache::LookupSlow(uint16_t pc)
+{
+    retired.clear();
+
+    // OAM DMA hides everything below FF00: the CPU fetches 0xFF there, not
+    // the code that is cached for it
+    if (pc < 0xFF00 && dmaActive)
+        return nullptr;
+
+    uint32_t key = MakeKey(pc);
+    Block* block = nullptr;
+    auto it = blocks.find(key);
+    if (it != blocks.end())
+        block = it->second.get();
+    else
+        block = Decode(pc, key);
+
+    fastLookup[pc] = block;
+    return block;
+}
+
+Block* BlockCache::Decode(uint16_t pc, uint32_t key)
+{
+    uint16_t regionEnd;
+    if (!CodeRegion(pc, regionEnd))
+        return nullptr;
+
+    if (blocks.size() >= kMaxBlocks)
+        Clear();
+
+    auto block = std::make_unique<Block>();
+    block->key = key;
+    block->startPC = pc;
+
+    uint32_t addr = pc;
+    while (block->ops.size() < kMaxOpsPerBlock)
+    {
+        uint8_t opcode = mmu->Peek8(static_cast<uint16_t>(addr));
+        const OpcodeInfo& info = kOpcodeTable[opcode];
+        if (addr + info.length - 1 > regionEnd)
+            break;
+
+        MicroOp op;
+        op.exec = handlers[opcode];
+        op.length = info.length;
+        op.opcode = opcode;
+        if (info.length == 3)
+            op.operand = mmu->Peek16(static_cast<uint16_t>(addr + 1));
+        else if (info.length == 2)
+            op.operand = mmu->Peek8(static_cast<uint16_t>(addr + 1));
+        else
+            op.operand = 0;
+        block->ops.push_back(op);
+        block->maxCycles += std::max<uint32_t>(InstructionCycles(opcode, static_cast<uint8_t>(op.operand)), info.cyclesTaken);
+
+        addr += info.length;
+        if (EndsBasicBlock(opcode))
+            break;
+    }
+
+    // Nothing fits before the region boundary: let the interpreter handle it
+    if (block->ops.empty())
+        return nullptr;
+
+    block->endPC = static_cast<uint16_t>(addr);
+
+    // Code in RAM can be overwritten; ROM never changes under a given key
+    if (pc >= 0x8000)
+    {
+        for (uint32_t page = pc >> 8; page <= ((addr - 1) >> 8); page++)
+        {
+            pageBlocks[page].push_back(key);
+            mmu->SetCodePage(static_cast<uint8_t>(page), true);
+        }
+    }
+
+    Block* raw = block.get();
+    blocks.emplace(key, std::move(block));
+    return raw;
+}
+
+void BlockCache::Retire(uint32_t key)
+{
+    auto it = blocks.find(key);
+    if (it == blocks.end())
+        return;
+
+    Block* block = it->second.get();
+    if (fastLookup[block->startPC] == block)
+        fastLookup[block->startPC] = nullptr;
+
+    retired.push_back(std::move(it->second));
+    blocks.erase(it);
+}
+
+void BlockCache::InvalidatePage(uint8_t page)
+{
+    for (uint32_t key : pageBlocks[page])
+        Retire(key);
+    pageBlocks[page].clear();
+    mmu->SetCodePage(page, false);
+    epoch++;
+}
+
+void BlockCache::Clear()
+{
+    for (auto& entry : blocks)
+        retired.push_back(std::move(entry.second));
+    blocks.clear();
+    std::fill(fastLookup.begin(), fastLookup.end(), nullptr);
+    for (int page = 0; page < 256; page++)
+    {
+        if (!pageBlocks[page].empty())
+            mmu->SetCodePage(static_cast<uint8_t>(page), false);
+        pageBlocks[page].clear();
+    }
+    epoch++;
+
+    // The old ROM's translations would otherwise fill the code cache until
+    // the next flush
+    if (jit)
+        jit->Flush();
+}
+
+void BlockCache::DropNativeCode()
+{
+    for (auto& entry : blocks)
+    {
+        entry.second->native = nullptr;
+        entry.second->hits = 0;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class CPU;
+class MMU;
+class Jit;
+
+// One pre-decoded instruction: handler, operand bytes already fetched
+struct MicroOp
+{
+    int (*exec)(CPU&, uint16_t operand);
+    uint16_t operand;
+    uint8_t length;
+    uint8_t opcode;
+};
+
+// Straight-line run of instructions ending at the first branch, HALT/STOP,
+// DI/EI, or region boundary
+struct Block
+{
+    using NativeCode = int (*)(CPU*);
+
+    uint32_t key;      // (bank << 16) | start PC
+    uint16_t startPC;
+    uint16_t endPC;    // one past the last decoded byte
+    std::vector<MicroOp> ops;
+    uint32_t maxCycles = 0; // a run to the end, taking the closing branch
+
+    uint32_t hits = 0;             // executions, for JIT hotness
+    NativeCode native = nullptr;   // set once the JIT has translated the block
+};
+
+// Decodes code from ROM, WRAM and HRAM once and hands back cached blocks keyed
+// by (bank, PC). Blocks in RAM register their pages with the MMU so that a
+// write to any of those pages drops them.
+class BlockCache
+{
+public:
+    using Handler = int (*)(CPU&, uint16_t operand);
+
+    BlockCache(MMU* mmu, const Handler* handlers);
+    ~BlockCache();
+
+    // Cached or freshly decoded block starting at pc; nullptr when pc lies
+    // outside ROM/WRAM/HRAM and must be interpreted. Runs once per block, so
+    // the hit is inline: one table load and a key compare.
+    Block* Lookup(uint16_t pc)
+    {
+        Block* block = fastLookup[pc];
+        if (block && block->key == MakeKey(pc) && !(dmaActive && pc < 0xFF00))
+            return block;
+        return LookupSlow(pc);
+    }
+
+    // Drop every block overlapping a 256-byte page (called by MMU on writes)
+    void InvalidatePage(uint8_t page);
+
+    // Drop everything (ROM reload), including the JIT's translations
+    void Clear();
+
+    // The JIT whose code cache Clear flushes (set by the Jit itself)
+    void SetJit(Jit* owner) { jit = owner; }
+
+    // A bank switch, or OAM DMA starting or ending: blocks stay cached under
+    // their (bank, PC) keys, but the one running must not continue past the
+    // switching write
+    void OnBankSwitch();
+
+    // Forget all JIT translations but keep the decoded blocks
+    void DropNativeCode();
+
+    // Bumped by every invalidation so a running block can notice it was hit
+    uint32_t GetEpoch() const { return epoch; }
+    const uint32_t* GetEpochAddress() const { return &epoch; }
+    size_t GetBlockCount() const { return blocks.size(); }
+
+private:
+    static constexpr size_t kMaxOpsPerBlock = 64;
+    static constexpr size_t kMaxBlocks = 1 << 16;
+
+    MMU* mmu;
+    const Handler* handlers;
+    Jit* jit = nullptr;
+
+    std::unordered_map<uint32_t, std::unique_ptr<Block>> blocks;
+    std::vector<Block*> fastLookup;                 // indexed by PC, validated against bank
+    std::vector<uint32_t> pageBlocks[256];          // RAM pages -> keys of blocks using them
+    std::vector<std::unique_ptr<Block>> retired;    // invalidated, freed on the next miss
+    uint32_t epoch = 0;
+
+    // The memory map as of the last OnBankSwitch, so that a hit needs no MMU call
+    uint16_t bank0 = 0;
+    uint16_t bankX = 1;
+    bool dmaActive = false;
+
+    uint32_t MakeKey(uint16_t pc) const
+    {
+        const uint32_t bank = pc < 0x4000 ? bank0 : pc < 0x8000 ? bankX : 0;
+        return (bank << 16) | pc;
+    }
+    Block* LookupSlow(uint16_t pc);
+    Block* Decode(uint16_t pc, uint32_t key);
+    void Retire(uint32_t key);
+};
@@ -1,343 +1,448 @@
 #include "CPU.h"
 #include "MMU.h"
+#include "Opcodes.h"
+#include "BlockCache.h"
+#include "Jit.h"
+#include "Scheduler.h"
+#include "IdleLoop.h"
+#include "Interrupts.h"
+#include <algorithm>
 #include <SDL3/SDL.h> // for optional logging
 
-CPU::CPU(MMU* mmu) : mmu(mmu) {
+CPU::CPU(MMU* mmu) : mmu(mmu), scheduler(&mmu->GetScheduler()), interrupts(&mmu->GetInterrupts()) {
+    SetIdleLoopSkipEnabled(true);
     Reset();
 }
 
+CPU::~CPU() {
+    // The JIT refers to the block cache; tear down in dependency order
+    jit.reset();
+    blockCache.reset();
+}
+
 void CPU::Reset() {
-    A = F = B = C = D = E = H = L = 0;
+    AF = BC = DE = HL = 0;
+    flagOp = FlagOp::None;
     SP = 0xFFFE;
     PC = 0x0100; // entry point after BIOS
+    interrupts->Disable();
+    interrupts->Wake();
+    if (idleLoops)
+        idleLoops->Reset();
 }
 
 // --- Step / Fetch ---
 int CPU::Step() {
+    if (interrupts->NeedsService()) {
+        if (const int cycles = Service())
+            return cycles;
+    }
+
+    if (blockCache)
+        return StepBlock();
+
     uint8_t opcode = Fetch8();
+    int cycles = dispatchTable[opcode](*this);
+    scheduler->Advance(cycles);
+    return cycles;
+}
+
+int CPU::Service() {
+    if (interrupts->IsHalted()) {
+        const uint8_t wake = interrupts->IsStopped() ? (interrupts->GetRequested() & Interrupts::INT_JOYPAD)
+                                                     : interrupts->GetPending();
+        if (!wake)
+            return FastForward();
+        interrupts->Wake();
+    }
+
+    if (interrupts->IsEnableDelayed()) {
+        // EI: IME is set, but only the instruction after EI gets to run first
+        interrupts->Enable();
+        uint8_t opcode = Fetch8();
+        int cycles = dispatchTable[opcode](*this);
+        scheduler->Advance(cycles);
+        return cycles;
+    }
+
+    if (!interrupts->IsMasterEnabled() || !interrupts->GetPending())
+        return 0;
+
+    // Dispatch: two wait states, push PC, jump to the vector
+    RST(interrupts->Acknowledge());
+    constexpr int cycles = 20;
+    scheduler->Advance(cycles);
+    return cycles;
+}
+
+int CPU::FastForward() {
+    const uint64_t next = scheduler->NextEventTime();
+    const uint64_t now = scheduler->Now();
+    uint64_t cycles = next == Scheduler::kNever ? kIdleChunk : next - now;
+    cycles = std::clamp<uint64_t>((cycles + 3) & ~uint64_t(3), 4, kIdleChunk); // whole M-cycles
+    scheduler->Advance(static_cast<uint32_t>(cycles));
+    return static_cast<int>(cycles);
+}
+
+int CPU::BackwardJump(uint16_t end, int cycles) {
+    if (idleLoops && PC < end)
+        cycles += static_cast<int>(idleLoops->OnBackwardJump(*this, PC, end, static_cast<uint32_t>(cycles)));
+    return cycles;
+}
+
+// Run one cached block. Memory side effects still go through the MMU, so the
+// only difference from stepping is skipping fetch and decode. A write that
+// invalidates cached code stops the block right after the writing instruction,
+// and so does anything that needs Service() (an interrupt, HALT, EI).
+// The clock advances per instruction here too (native code does the same
+// before each interpreter call), so devices see the same time as when stepping.
+int CPU::StepBlock() {
+    Block* block = blockCache->Lookup(PC);
+    if (!block) {
+        uint8_t opcode = Fetch8();
+        int cycles = dispatchTable[opcode](*this);
+        scheduler->Advance(cycles);
+        return cycles;
+    }
+
+    // A block that jumps back to its own start runs again without going back
+    // through Step and Lookup, which for a loop of a few instructions cost
+    // more than the instructions themselves
+    const uint32_t epoch = blockCache->GetEpoch();
+    int cycles = 0;
+    do {
+        // Native code only runs blocks that finish before the next event, so an
+        // interrupt an event raises is still taken at the right instruction
+        if (jit && scheduler->Now() + block->maxCycles < scheduler->NextEventTime() &&
+            (block->native || (++block->hits == Jit::kHotThreshold && jit->Compile(*block)))) {
+            // Native code reads and writes F directly
+            MaterializeFlags();
+            cycles += block->native(this);
+            if (blockCache->GetEpoch() != epoch || interrupts->NeedsService())
+                return cycles;
+            continue;
+        }
+
+        for (const MicroOp& op : block->ops) {
+            PC += op.length;
+            const int opCycles = op.exec(*this, op.operand);
+            scheduler->Advance(opCycles);
+            cycles += opCycles;
+            if (blockCache->GetEpoch() != epoch || interrupts->NeedsService())
+                return cycles;
+        }
+    } while (PC == block->startPC && cycles < kChainCycles && !scheduler->IsBreakRequested());
+    return cycles;
+}
+
+void CPU::SetBlockCacheEnabled(bool enabled) {
+    if (enabled && !blockCache) {
+        blockCache = std::make_unique<BlockCache>(mmu, decodedTable.data());
+    } else if (!enabled) {
+        jit.reset();
+        blockCache.reset();
+    }
+}
+
+void CPU::SetJitEnabled(bool enabled) {
+    if (enabled && !jit && Jit::IsSupported()) {
+        SetBlockCacheEnabled(true);
+        jit = std::make_unique<Jit>(this, blockCache.get(), decodedTable.data());
+    } else if (!enabled && jit) {
+        jit->Flush();
+        jit.reset();
+    }
+}
+
+void CPU::SetIdleLoopSkipEnabled(bool enabled) {
+    if (enabled && !idleLoops)
+        idleLoops = std::make_unique<IdleLoopDetector>(mmu, scheduler);
+    else if (!enabled)
+        idleLoops.reset();
+}
+
+bool CPU::IsHalted() const {
+    return interrupts->IsHalted();
+}
+
+bool CPU::IsStopped() const {
+    return interrupts->IsStopped();
+}
+
+uint64_t CPU::GetIdleSkippedCycles() const {
+    return idleLoops ? idleLoops->GetStats().skippedCycles : 0;
+}
+
+// --- Opcode dispatch ---
+// Operand bytes are fetched according to the opcode's metadata length, so each
+// generated handler is the fetch plus the straight-line body for that opcode.
+template<uint8_t OP>
+int CPU::Dispatch(CPU& cpu) {
+    constexpr uint8_t length = kOpcodeTable[OP].length;
+    if constexpr (length == 3)
+        return cpu.Execute<OP>(cpu.Fetch16());
+    else if constexpr (length == 2)
+        return cpu.Execute<OP>(cpu.Fetch8());
+    else
+        return cpu.Execute<OP>(0);
+}
+
+template<uint8_t OP>
+int CPU::DispatchDecoded(CPU& cpu, uint16_t operand) {
+    return cpu.Execute<OP>(operand);
+}
+
+template<size_t... OPS>
+constexpr auto CPU::MakeDispatchTable(std::index_sequence<OPS...>) {
+    return std::array<OpHandler, sizeof...(OPS)>{ &CPU::Dispatch<static_cast<uint8_t>(OPS)>... };
+}
+
+template<size_t... OPS>
+constexpr auto CPU::MakeDecodedTable(std::index_sequence<OPS...>) {
+    return std::array<DecodedHandler, sizeof...(OPS)>{ &CPU::DispatchDecoded<static_cast<uint8_t>(OPS)>... };
+}
+
+const std::array<CPU::OpHandler, 256> CPU::dispatchTable = CPU::MakeDispatchTable(std::make_index_sequence<256>{});
+const std::array<CPU::DecodedHandler, 256> CPU::decodedTable = CPU::MakeDecodedTable(std::make_index_sequence<256>{});
+
+// CB page: xx yyy zzz where xx selects rotate/shift (yyy = which), BIT, RES or
+// SET (yyy = bit index) and zzz the register. All three fields are template
+// constants, so every entry is straight-line code on a fixed operand.
+template<uint8_t CB>
+int CPU::DispatchCB(CPU& cpu) {
+    constexpr int X = CB >> 6;
+    constexpr int Y = (CB >> 3) & 7;
+    constexpr int Z = CB & 7;
+
+    uint8_t val = cpu.ReadOperand8<Z>();
+    if constexpr (X == 1) {
+        cpu.BIT_b<Y>(val);
+    } else {
+        if constexpr (X == 0) cpu.Shift<Y>(val);
+        else if constexpr (X == 2) cpu.RES_b<Y>(val);
+        else cpu.SET_b<Y>(val);
+        cpu.WriteOperand8<Z>(val);
+    }
+    return kCBOpcodeTable[CB].cycles;
+}
+
+template<size_t... OPS>
+constexpr auto CPU::MakeCBDispatchTable(std::index_sequence<OPS...>) {
+    return std::array<OpHandler, sizeof...(OPS)>{ &CPU::DispatchCB<static_cast<uint8_t>(OPS)>... };
+}
+
+const std::array<CPU::OpHandler, 256> CPU::cbDispatchTable = CPU::MakeCBDispatchTable(std::make_index_sequence<256>{});
+
+template<int R>
+uint8_t& CPU::Reg8() {
+    static_assert(R != 6, "(HL) is a memory operand");
+    if constexpr (R == 0) return B;
+    else if constexpr (R == 1) return C;
+    else if constexpr (R == 2) return D;
+    else if constexpr (R == 3) return E;
+    else if constexpr (R == 4) return H;
+    else if constexpr (R == 5) return L;
+    else return A;
+}
+
+template<int R>
+uint8_t CPU::ReadOperand8() {
+    if constexpr (R == 6) return mmu->Read8(HL);
+    else return Reg8<R>();
+}
+
+template<int R>
+void CPU::WriteOperand8(uint8_t val) {
+    if constexpr (R == 6) mmu->Write8(HL, val);
+    else Reg8<R>() = val;
+}
+
+template<int OPN>
+void CPU::Shift(uint8_t& val) {
+    if constexpr (OPN == 0) RLC_r(val);
+    else if constexpr (OPN == 1) RRC_r(val);
+    else if constexpr (OPN == 2) RL_r(val);
+    else if constexpr (OPN == 3) RR_r(val);
+    else if constexpr (OPN == 4) SLA_r(val);
+    else if constexpr (OPN == 5) SRA_r(val);
+    else if constexpr (OPN == 6) SWAP_r(val);
+    else SRL_r(val);
+}
+
+template<int OPN>
+void CPU::ALU(uint8_t val) {
+    if constexpr (OPN == 0) ADD_A_r(val);
+    else if constexpr (OPN == 1) ADC_A_r(val);
+    else if constexpr (OPN == 2) SUB_A_r(val);
+    else if constexpr (OPN == 3) SBC_A_r(val);
+    else if constexpr (OPN == 4) AND_A_r(val);
+    else if constexpr (OPN == 5) XOR_A_r(val);
+    else if constexpr (OPN == 6) OR_A_r(val);
+    else CP_A_r(val);
+}
+
+// Opcode bits are decoded as xx yyy zzz; the regular blocks (LD r,r / ALU A,r /
+// INC/DEC r / LD r,n) are expanded from those fields, everything else is listed.
+template<uint8_t OP>
+int CPU::Execute(uint16_t operand) {
+    constexpr OpcodeInfo info = kOpcodeTable[OP];
+    constexpr int X = OP >> 6;
+    constexpr int Y = (OP >> 3) & 7;
+    constexpr int Z = OP & 7;
+    [[maybe_unused]] const uint8_t n = static_cast<uint8_t>(operand);
+    [[maybe_unused]] const int8_t e = static_cast<int8_t>(operand);
+
+    // HALT sits in the middle of the LD r,r block
+    if constexpr (OP == 0x76) HALT();
+
+    // LD r, r / LD r, (HL) / LD (HL), r
+    else if constexpr (X == 1) {
+        if constexpr (Z == 6) LD_r_HL(Reg8<Y>());
+        else if constexpr (Y == 6) LD_HL_r(Reg8<Z>());
+        else LD_r_r(Reg8<Y>(), Reg8<Z>());
+    }
+
+    // ADD/ADC/SUB/SBC/AND/XOR/OR/CP A, r
+    else if constexpr (X == 2) ALU<Y>(ReadOperand8<Z>());
+
+    // INC r / DEC r / LD r, n
+    else if constexpr (X == 0 && Z == 4) {
+        if constexpr (Y == 6) INC_HLmem(); else INC_r(Reg8<Y>());
+    }
+    else if constexpr (X == 0 && Z == 5) {
+        if constexpr (Y == 6) DEC_HLmem(); else DEC_r(Reg8<Y>());
+    }
+    else if constexpr (X == 0 && Z == 6) {
+        if constexpr (Y == 6) LD_HL_n(n); else LD_r_n(Reg8<Y>(), n);
+    }
+
+    // ALU A, n
+    else if constexpr (X == 3 && Z == 6) ALU<Y>(n);
+
+    // RST n
+    else if constexpr (X == 3 && Z == 7) RST(Y * 8);
+
+    // Misc / control
+    else if constexpr (OP == 0x00) NOP();
+    else if constexpr (OP == 0x10) STOP();
+    else if constexpr (OP == 0xF3) DI();
+    else if constexpr (OP == 0xFB) EI();
 
-    switch (opcode) {
-    // NOP
-    case 0x00: NOP(); return 4;
-    
-    // LD r, n (8-bit immediate loads)
-    case 0x06: LD_r_n(B); return 8;
-    case 0x0E: LD_r_n(C); return 8;
-    case 0x16: LD_r_n(D); return 8;
-    case 0x1E: LD_r_n(E); return 8;
-    case 0x26: LD_r_n(H); return 8;
-    case 0x2E: LD_r_n(L); return 8;
-    case 0x3E: LD_r_n(A); return 8;
-    
-    // LD r, r (register to register)
-    case 0x40: LD_r_r(B, B); return 4;
-    case 0x41: LD_r_r(B, C); return 4;
-    case 0x42: LD_r_r(B, D); return 4;
-    case 0x43: LD_r_r(B, E); return 4;
-    case 0x44: LD_r_r(B, H); return 4;
-    case 0x45: LD_r_r(B, L); return 4;
-    case 0x46: LD_r_HL(B); return 8;
-    case 0x47: LD_r_r(B, A); return 4;
-    case 0x48: LD_r_r(C, B); return 4;
-    case 0x49: LD_r_r(C, C); return 4;
-    case 0x4A: LD_r_r(C, D); return 4;
-    case 0x4B: LD_r_r(C, E); return 4;
-    case 0x4C: LD_r_r(C, H); return 4;
-    case 0x4D: LD_r_r(C, L); return 4;
-    case 0x4E: LD_r_HL(C); return 8;
-    case 0x4F: LD_r_r(C, A); return 4;
-    case 0x50: LD_r_r(D, B); return 4;
-    case 0x51: LD_r_r(D, C); return 4;
-    case 0x52: LD_r_r(D, D); return 4;
-    case 0x53: LD_r_r(D, E); return 4;
-    case 0x54: LD_r_r(D, H); return 4;
-    case 0x55: LD_r_r(D, L); return 4;
-    case 0x56: LD_r_HL(D); return 8;
-    case 0x57: LD_r_r(D, A); return 4;
-    case 0x58: LD_r_r(E, B); return 4;
-    case 0x59: LD_r_r(E, C); return 4;
-    case 0x5A: LD_r_r(E, D); return 4;
-    case 0x5B: LD_r_r(E, E); return 4;
-    case 0x5C: LD_r_r(E, H); return 4;
-    case 0x5D: LD_r_r(E, L); return 4;
-    case 0x5E: LD_r_HL(E); return 8;
-    case 0x5F: LD_r_r(E, A); return 4;
-    case 0x60: LD_r_r(H, B); return 4;
-    case 0x61: LD_r_r(H, C); return 4;
-    case 0x62: LD_r_r(H, D); return 4;
-    case 0x63: LD_r_r(H, E); return 4;
-    case 0x64: LD_r_r(H, H); return 4;
-    case 0x65: LD_r_r(H, L); return 4;
-    case 0x66: LD_r_HL(H); return 8;
-    case 0x67: LD_r_r(H, A); return 4;
-    case 0x68: LD_r_r(L, B); return 4;
-    case 0x69: LD_r_r(L, C); return 4;
-    case 0x6A: LD_r_r(L, D); return 4;
-    case 0x6B: LD_r_r(L, E); return 4;
-    case 0x6C: LD_r_r(L, H); return 4;
-    case 0x6D: LD_r_r(L, L); return 4;
-    case 0x6E: LD_r_HL(L); return 8;
-    case 0x6F: LD_r_r(L, A); return 4;
-    case 0x70: LD_HL_r(B); return 8;
-    case 0x71: LD_HL_r(C); return 8;
-    case 0x72: LD_HL_r(D); return 8;
-    case 0x73: LD_HL_r(E); return 8;
-    case 0x74: LD_HL_r(H); return 8;
-    case 0x75: LD_HL_r(L); return 8;
-    case 0x76: HALT(); return 4;
-    case 0x77: LD_HL_r(A); return 8;
-    case 0x78: LD_r_r(A, B); return 4;
-    case 0x79: LD_r_r(A, C); return 4;
-    case 0x7A: LD_r_r(A, D); return 4;
-    case 0x7B: LD_r_r(A, E); return 4;
-    case 0x7C: LD_r_r(A, H); return 4;
-    case 0x7D: LD_r_r(A, L); return 4;
-    case 0x7E: LD_r_HL(A); return 8;
-    case 0x7F: LD_r_r(A, A); return 4;
-    
-    // LD (HL), n
-    case 0x36: LD_HL_n(); return 12;
-    
-    // INC r (8-bit)
-    case 0x04: INC_r(B); return 4;
-    case 0x0C: INC_r(C); return 4;
-    case 0x14: INC_r(D); return 4;
-    case 0x1C: INC_r(E); return 4;
-    case 0x24: INC_r(H); return 4;
-    case 0x2C: INC_r(L); return 4;
-    case 0x34: INC_HLmem(); return 12;
-    case 0x3C: INC_r(A); return 4;
-    
-    // DEC r (8-bit)
-    case 0x05: DEC_r(B); return 4;
-    case 0x0D: DEC_r(C); return 4;
-    case 0x15: DEC_r(D); return 4;
-    case 0x1D: DEC_r(E); return 4;
-    case 0x25: DEC_r(H); return 4;
-    case 0x2D: DEC_r(L); return 4;
-    case 0x35: DEC_HLmem(); return 12;
-    case 0x3D: DEC_r(A); return 4;
-    
     // 16-bit loads
-    case 0x01: { SetBC(Fetch16()); return 12; }
-    case 0x11: { SetDE(Fetch16()); return 12; }
-    case 0x21: { SetHL(Fetch16()); return 12; }
-    case 0x31: { SP = Fetch16(); return 12; }
-    case 0x0A: LD_A_BC(); return 8;
-    case 0x1A: LD_A_DE(); return 8;
-    case 0x2A: LD_A_HLinc(); return 8;
-    case 0x3A: LD_A_HLdec(); return 8;
-    case 0x02: LD_BC_A(); return 8;
-    case 0x12: LD_DE_A(); return 8;
-    case 0x22: LD_HLinc_A(); return 8;
-    case 0x32: LD_HLdec_A(); return 8;
-    case 0xFA: LD_A_nn(); return 16;
-    case 0xEA: LD_nn_A(); return 16;
-    case 0xF2: LD_A_C(); return 8;
-    case 0xE2: LD_C_A(); return 8;
-    case 0xF9: { SP = GetHL(); return 8; }
-    case 0xF8: LD_HL_SPn(); return 12;
-    
+    else if constexpr (OP == 0x01) BC = operand;
+    else if constexpr (OP == 0x11) DE = operand;
+    else if constexpr (OP == 0x21) HL = operand;
+    else if constexpr (OP == 0x31) LD_SP_nn(operand);
+    else if constexpr (OP == 0x08) LD_nn_SP(operand);
+    else if constexpr (OP == 0xF9) SP = HL;
+    else if constexpr (OP == 0xF8) LD_HL_SPn(e);
+
+    // Indirect 8-bit loads
+    else if constexpr (OP == 0x0A) LD_A_BC();
+    else if constexpr (OP == 0x1A) LD_A_DE();
+    else if constexpr (OP == 0x2A) LD_A_HLinc();
+    else if constexpr (OP == 0x3A) LD_A_HLdec();
+    else if constexpr (OP == 0x02) LD_BC_A();
+    else if constexpr (OP == 0x12) LD_DE_A();
+    else if constexpr (OP == 0x22) LD_HLinc_A();
+    else if constexpr (OP == 0x32) LD_HLdec_A();
+    else if constexpr (OP == 0xFA) LD_A_nn(operand);
+    else if constexpr (OP == 0xEA) LD_nn_A(operand);
+    else if constexpr (OP == 0xF2) LD_A_C();
+    else if constexpr (OP == 0xE2) LD_C_A();
+    else if constexpr (OP == 0xF0) LDH_A_n(n);
+    else if constexpr (OP == 0xE0) LDH_n_A(n);
+
     // 16-bit INC/DEC
-    case 0x03: INC_BC(); return 8;
-    case 0x13: INC_DE(); return 8;
-    case 0x23: INC_HL(); return 8;
-    case 0x33: INC_SP(); return 8;
-    case 0x0B: DEC_BC(); return 8;
-    case 0x1B: DEC_DE(); return 8;
-    case 0x2B: DEC_HL(); return 8;
-    case 0x3B: DEC_SP(); return 8;
-    
-    // ADD HL, rr (16-bit addition)
-    case 0x09: ADD_HL_BC(); return 8;
-    case 0x19: ADD_HL_DE(); return 8;
-    case 0x29: ADD_HL_HL(); return 8;
-    case 0x39: ADD_HL_SP(); return 8;
-    
-    // ADD A, r
-    case 0x80: ADD_A_r(B); return 4;
-    case 0x81: ADD_A_r(C); return 4;
-    case 0x82: ADD_A_r(D); return 4;
-    case 0x83: ADD_A_r(E); return 4;
-    case 0x84: ADD_A_r(H); return 4;
-    case 0x85: ADD_A_r(L); return 4;
-    case 0x86: ADD_A_HL(); return 8;
-    case 0x87: ADD_A_r(A); return 4;
-    case 0xC6: ADD_A_n(); return 8;
-    
-    // ADC A, r
-    case 0x88: ADC_A_r(B); return 4;
-    case 0x89: ADC_A_r(C); return 4;
-    case 0x8A: ADC_A_r(D); return 4;
-    case 0x8B: ADC_A_r(E); return 4;
-    case 0x8C: ADC_A_r(H); return 4;
-    case 0x8D: ADC_A_r(L); return 4;
-    case 0x8E: ADC_A_HL(); return 8;
-    case 0x8F: ADC_A_r(A); return 4;
-    case 0xCE: ADC_A_n(); return 8;
-    
-    // SUB A, r
-    case 0x90: SUB_A_r(B); return 4;
-    case 0x91: SUB_A_r(C); return 4;
-    case 0x92: SUB_A_r(D); return 4;
-    case 0x93: SUB_A_r(E); return 4;
-    case 0x94: SUB_A_r(H); return 4;
-    case 0x95: SUB_A_r(L); return 4;
-    case 0x96: SUB_A_HL(); return 8;
-    case 0x97: SUB_A_r(A); return 4;
-    case 0xD6: SUB_A_n(); return 8;
-    
-    // SBC A, r
-    case 0x98: SBC_A_r(B); return 4;
-    case 0x99: SBC_A_r(C); return 4;
-    case 0x9A: SBC_A_r(D); return 4;
-    case 0x9B: SBC_A_r(E); return 4;
-    case 0x9C: SBC_A_r(H); return 4;
-    case 0x9D: SBC_A_r(L); return 4;
-    case 0x9E: SBC_A_HL(); return 8;
-    case 0x9F: SBC_A_r(A); return 4;
-    case 0xDE: SBC_A_n(); return 8;
-    
-    // AND A, r
-    case 0xA0: AND_A_r(B); return 4;
-    case 0xA1: AND_A_r(C); return 4;
-    case 0xA2: AND_A_r(D); return 4;
-    case 0xA3: AND_A_r(E); return 4;
-    case 0xA4: AND_A_r(H); return 4;
-    case 0xA5: AND_A_r(L); return 4;
-    case 0xA6: AND_A_HL(); return 8;
-    case 0xA7: AND_A_r(A); return 4;
-    case 0xE6: AND_A_n(); return 8;
-    
-    // OR A, r
-    case 0xB0: OR_A_r(B); return 4;
-    case 0xB1: OR_A_r(C); return 4;
-    case 0xB2: OR_A_r(D); return 4;
-    case 0xB3: OR_A_r(E); return 4;
-    case 0xB4: OR_A_r(H); return 4;
-    case 0xB5: OR_A_r(L); return 4;
-    case 0xB6: OR_A_HL(); return 8;
-    case 0xB7: OR_A_r(A); return 4;
-    case 0xF6: OR_A_n(); return 8;
-    
-    // XOR A, r
-    case 0xA8: XOR_A_r(B); return 4;
-    case 0xA9: XOR_A_r(C); return 4;
-    case 0xAA: XOR_A_r(D); return 4;
-    case 0xAB: XOR_A_r(E); return 4;
-    case 0xAC: XOR_A_r(H); return 4;
-    case 0xAD: XOR_A_r(L); return 4;
-    case 0xAE: XOR_A_HL(); return 8;
-    case 0xAF: XOR_A_r(A); return 4;
-    case 0xEE: XOR_A_n(); return 8;
-    
-    // CP A, r
-    case 0xB8: CP_A_r(B); return 4;
-    case 0xB9: CP_A_r(C); return 4;
-    case 0xBA: CP_A_r(D); return 4;
-    case 0xBB: CP_A_r(E); return 4;
-    case 0xBC: CP_A_r(H); return 4;
-    case 0xBD: CP_A_r(L); return 4;
-    case 0xBE: CP_A_HL(); return 8;
-    case 0xBF: CP_A_r(A); return 4;
-    case 0xFE: CP_A_n(); return 8;
-    
-    // Rotates
-    case 0x07: RLC_A(); return 4;
-    case 0x0F: RRC_A(); return 4;
-    case 0x17: RL_A(); return 4;
-    case 0x1F: RR_A(); return 4;
-    
-    // Miscellaneous
-    case 0x27: DAA(); return 4;
-    case 0x2F: CPL(); return 4;
-    case 0x37: SCF(); return 4;
-    case 0x3F: CCF(); return 4;
-    
-    // Jumps
-    case 0xC3: { uint16_t addr = Fetch16(); JP(addr); return 16; }
-    case 0xC2: { uint16_t addr = Fetch16(); bool taken = !GetFlag(FLAG_Z); JP_NZ(addr); return taken ? 16 : 12; }
-    case 0xCA: { uint16_t addr = Fetch16(); bool taken = GetFlag(FLAG_Z); JP_Z(addr); return taken ? 16 : 12; }
-    case 0xD2: { uint16_t addr = Fetch16(); bool taken = !GetFlag(FLAG_C); JP_NC(addr); return taken ? 16 : 12; }
-    case 0xDA: { uint16_t addr = Fetch16(); bool taken = GetFlag(FLAG_C); JP_C(addr); return taken ? 16 : 12; }
-    case 0xE9: { PC = GetHL(); return 4; } // JP (HL)
-    
-    // Relative jumps
-    case 0x18: { int8_t offset = static_cast<int8_t>(Fetch8()); JR(offset); return 12; }
-    case 0x20: { int8_t offset = static_cast<int8_t>(Fetch8()); bool taken = !GetFlag(FLAG_Z); JR_NZ(offset); return taken ? 12 : 8; }
-    case 0x28: { int8_t offset = static_cast<int8_t>(Fetch8()); bool taken = GetFlag(FLAG_Z); JR_Z(offset); return taken ? 12 : 8; }
-    case 0x30: { int8_t offset = static_cast<int8_t>(Fetch8()); bool taken = !GetFlag(FLAG_C); JR_NC(offset); return taken ? 12 : 8; }
-    case 0x38: { int8_t offset = static_cast<int8_t>(Fetch8()); bool taken = GetFlag(FLAG_C); JR_C(offset); return taken ? 12 : 8; }
-    
-    // Calls
-    case 0xCD: { uint16_t addr = Fetch16(); CALL(addr); return 24; }
-    case 0xC4: { uint16_t addr = Fetch16(); bool taken = !GetFlag(FLAG_Z); CALL_NZ(addr); return taken ? 24 : 12; }
-    case 0xCC: { uint16_t addr = Fetch16(); bool taken = GetFlag(FLAG_Z); CALL_Z(addr); return taken ? 24 : 12; }
-    case 0xD4: { uint16_t addr = Fetch16(); bool taken = !GetFlag(FLAG_C); CALL_NC(addr); return taken ? 24 : 12; }
-    case 0xDC: { uint16_t addr = Fetch16(); bool taken = GetFlag(FLAG_C); CALL_C(addr); return taken ? 24 : 12; }
-    
-    // Returns
-    case 0xC9: RET(); return 16;
-    case 0xC0: { bool taken = !GetFlag(FLAG_Z); RET_NZ(); return taken ? 20 : 8; }
-    case 0xC8: { bool taken = GetFlag(FLAG_Z); RET_Z(); return taken ? 20 : 8; }
-    case 0xD0: { bool taken = !GetFlag(FLAG_C); RET_NC(); return taken ? 20 : 8; }
-    case 0xD8: { bool taken = GetFlag(FLAG_C); RET_C(); return taken ? 20 : 8; }
-    case 0xD9: RETI(); return 16;
-    
-    // Stack operations
-    case 0xF5: PUSH_AF(); return 16;
-    case 0xC5: PUSH_BC(); return 16;
-    case 0xD5: PUSH_DE(); return 16;
-    case 0xE5: PUSH_HL(); return 16;
-    case 0xF1: POP_AF(); return 12;
-    case 0xC1: POP_BC(); return 12;
-    case 0xD1: POP_DE(); return 12;
-    case 0xE1: POP_HL(); return 12;
-    
-    // Interrupts and other
-    case 0xF3: DI(); return 4;
-    case 0xFB: EI(); return 4;
-    case 0x10: STOP(); return 4;
-    
-    default: {
-        SDL_Log("Unimplemented opcode: 0x%02X at PC=%04X", opcode, PC - 1);
-        NOP();
-        return 4;
+    else if constexpr (OP == 0x03) INC_BC();
+    else if constexpr (OP == 0x13) INC_DE();
+    else if constexpr (OP == 0x23) INC_HL();
+    else if constexpr (OP == 0x33) INC_SP();
+    else if constexpr (OP == 0x0B) DEC_BC();
+    else if constexpr (OP == 0x1B) DEC_DE();
+    else if constexpr (OP == 0x2B) DEC_HL();
+    else if constexpr (OP == 0x3B) DEC_SP();
+
+    // 16-bit arithmetic
+    else if constexpr (OP == 0x09) ADD_HL_BC();
+    else if constexpr (OP == 0x19) ADD_HL_DE();
+    else if constexpr (OP == 0x29) ADD_HL_HL();
+    else if constexpr (OP == 0x39) ADD_HL_SP();
+    else if constexpr (OP == 0xE8) ADD_SP_n(e);
+
+    // Accumulator rotates and flag ops
+    else if constexpr (OP == 0x07) RLC_A();
+    else if constexpr (OP == 0x0F) RRC_A();
+    else if constexpr (OP == 0x17) RL_A();
+    else if constexpr (OP == 0x1F) RR_A();
+    else if constexpr (OP == 0x27) DAA();
+    else if constexpr (OP == 0x2F) CPL();
+    else if constexpr (OP == 0x37) SCF();
+    else if constexpr (OP == 0x3F) CCF();
+
+    // Jumps, calls and returns
+    else if constexpr (OP == 0xC3 || OP == 0x18) {
+        const uint16_t end = PC;
+        if constexpr (OP == 0xC3) JP(operand);
+        else JR(e);
+        return BackwardJump(end, info.cycles);
     }
+    else if constexpr (OP == 0xE9) PC = HL; // JP (HL)
+    else if constexpr (OP == 0xCD) CALL(operand);
+    else if constexpr (OP == 0xC9) RET();
+    else if constexpr (OP == 0xD9) RETI();
+    else if constexpr (IsConditionalOpcode(OP)) {
+        // JR cc (0x20-0x38), RET cc / JP cc / CALL cc (0xC0-0xDC); cc in bits 3-4
+        bool taken = CheckCondition(Y & 3);
+        if (taken) {
+            const uint16_t end = PC;
+            if constexpr (X == 0) JR(e);
+            else if constexpr (Z == 0) RET();
+            else if constexpr (Z == 2) JP(operand);
+            else CALL(operand);
+            if constexpr (X == 0 || Z == 2)
+                return BackwardJump(end, info.cyclesTaken);
+        }
+        return taken ? info.cyclesTaken : info.cycles;
     }
+
+    // CB prefix: the operand byte selects the CB page entry, which reports
+    // the full cost of the prefixed instruction
+    else if constexpr (OP == 0xCB) return cbDispatchTable[n](*this);
+
+    // Stack operations
+    else if constexpr (OP == 0xF5) PUSH_AF();
+    else if constexpr (OP == 0xC5) PUSH_BC();
+    else if constexpr (OP == 0xD5) PUSH_DE();
+    else if constexpr (OP == 0xE5) PUSH_HL();
+    else if constexpr (OP == 0xF1) POP_AF();
+    else if constexpr (OP == 0xC1) POP_BC();
+    else if constexpr (OP == 0xD1) POP_DE();
+    else if constexpr (OP == 0xE1) POP_HL();
+
+    // Unused opcodes (0xD3, 0xDB, 0xDD, 0xE3, 0xE4, 0xEB-0xED, 0xF4, 0xFC, 0xFD)
+    else Unimplemented(OP);
+
+    return info.cycles;
 }
 
 // --- Instruction implementations ---
 void CPU::NOP() {}
 
-void CPU::LD_r_n(uint8_t& reg) {
-    reg = Fetch8();
+void CPU::LD_r_n(uint8_t& reg, uint8_t n) {
+    reg = n;
 }
 
 void CPU::INC_r(uint8_t& reg) {
     uint8_t old = reg;
     reg++;
-
-    if (reg == 0) F |= (1 << FLAG_Z);
-    else          F &= ~(1 << FLAG_Z);
-
-    F &= ~(1 << FLAG_N);
-
-    if ((old & 0x0F) + 1 > 0x0F) F |= (1 << FLAG_H);
-    else                         F &= ~(1 << FLAG_H);
+    RecordFlags(FlagOp::Inc, old, 1, reg, CarryFlag() != 0);
 }
 
 void CPU::DEC_r(uint8_t& reg) {
     uint8_t old = reg;
     reg--;
-
-    if (reg == 0) F |= (1 << FLAG_Z);
-    else          F &= ~(1 << FLAG_Z);
-
-    F |= (1 << FLAG_N);
-
-    if ((old & 0x0F) == 0) F |= (1 << FLAG_H);
-    else                   F &= ~(1 << FLAG_H);
+    RecordFlags(FlagOp::Dec, old, 1, reg, CarryFlag() != 0);
 }
 
 void CPU::JP(uint16_t addr) {
@@ -354,34 +459,92 @@ uint16_t CPU::Fetch16() {
 }
 
 // --- Register helpers ---
-uint16_t CPU::GetAF() { return (A << 8) | F; }
-uint16_t CPU::GetBC() { return (B << 8) | C; }
-uint16_t CPU::GetDE() { return (D << 8) | E; }
-uint16_t CPU::GetHL() { return (H << 8) | L; }
-
-void CPU::SetAF(uint16_t val) { A = val >> 8; F = val & 0xF0; }
-void CPU::SetBC(uint16_t val) { B = val >> 8; C = val & 0xFF; }
-void CPU::SetDE(uint16_t val) { D = val >> 8; E = val & 0xFF; }
-void CPU::SetHL(uint16_t val) { H = val >> 8; L = val & 0xFF; }
-
-void CPU::RunCycles(int n) {
-    int cycles = 0;
-    while (cycles < n)
-        cycles += Step();
+uint16_t CPU::GetAF() { return (A << 8) | ComputeFlags(); }
+void CPU::SetAF(uint16_t val) { A = val >> 8; F = val & 0xF0; flagOp = FlagOp::None; }
+
+CPU::Registers CPU::GetRegisters() const {
+    const uint8_t f = ComputeFlags();
+    return { A, f, B, C, D, E, H, L, static_cast<uint16_t>((A << 8) | f), BC, DE, HL, SP, PC };
+}
+
+int64_t CPU::RunUntil(uint64_t deadline) {
+    // The deadline is an ordinary event, so HALT fast-forwarding and idle-loop
+    // skipping stop at it as they would at any hardware event
+    if (scheduler->Now() < deadline) {
+        scheduler->ScheduleBreak(deadline);
+        while (!scheduler->IsBreakRequested())
+            Step();
+        scheduler->Cancel(EventType::Break);
+    }
+    return static_cast<int64_t>(scheduler->Now() - deadline);
 }
 
 // --- Flag helpers ---
 bool CPU::GetFlag(Flag flag) {
-    return (F & (1 << flag)) != 0;
+    if (flagOp != FlagOp::None) {
+        if (flag == FLAG_Z) return flagRes == 0;
+        if (flag == FLAG_C) return flagCarry != 0;
+    }
+    return (ComputeFlags() & (1 << flag)) != 0;
 }
 
 void CPU::SetFlag(Flag flag, bool value) {
+    MaterializeFlags();
     if (value)
         F |= (1 << flag);
     else
         F &= ~(1 << flag);
 }
 
+void CPU::RecordFlags(FlagOp op, uint8_t a, uint8_t b, uint8_t res, bool carry, uint8_t bits) {
+    flagOp = op;
+    flagA = a;
+    flagB = b;
+    flagRes = res;
+    flagCarry = carry ? (1 << FLAG_C) : 0;
+    flagBits = bits;
+    if constexpr (!kLazyFlags)
+        MaterializeFlags();
+}
+
+uint8_t CPU::ComputeFlags() const {
+    if (flagOp == FlagOp::None)
+        return F;
+
+    uint8_t flags = (flagRes == 0 ? (1 << FLAG_Z) : 0) | flagCarry;
+    const int a = flagA, b = flagB, cin = flagBits;
+    switch (flagOp) {
+        case FlagOp::Add:
+        case FlagOp::Adc:
+            if ((a & 0x0F) + (b & 0x0F) + cin > 0x0F) flags |= (1 << FLAG_H);
+            break;
+        case FlagOp::Sub:
+        case FlagOp::Sbc:
+            flags |= (1 << FLAG_N);
+            if ((a & 0x0F) < (b & 0x0F) + cin) flags |= (1 << FLAG_H);
+            break;
+        case FlagOp::Inc:
+            if ((a & 0x0F) == 0x0F) flags |= (1 << FLAG_H);
+            break;
+        case FlagOp::Dec:
+            flags |= (1 << FLAG_N);
+            if ((a & 0x0F) == 0) flags |= (1 << FLAG_H);
+            break;
+        case FlagOp::Bits:
+        default:
+            flags |= flagBits;
+            break;
+    }
+    return flags;
+}
+
+void CPU::MaterializeFlags() {
+    if (flagOp != FlagOp::None) {
+        F = ComputeFlags();
+        flagOp = FlagOp::None;
+    }
+}
+
 bool CPU::CheckCondition(uint8_t condition) {
     switch (condition) {
         case 0: return !GetFlag(FLAG_Z); // NZ
@@ -398,41 +561,38 @@ void CPU::LD_r_r(uint8_t& dest, uint8_t src) {
 }
 
 void CPU::LD_r_HL(uint8_t& reg) {
-    reg = mmu->Read8(GetHL());
+    reg = mmu->Read8(HL);
 }
 
 void CPU::LD_HL_r(uint8_t reg) {
-    mmu->Write8(GetHL(), reg);
+    mmu->Write8(HL, reg);
 }
 
-void CPU::LD_HL_n() {
-    uint8_t n = Fetch8();
-    mmu->Write8(GetHL(), n);
+void CPU::LD_HL_n(uint8_t n) {
+    mmu->Write8(HL, n);
 }
 
 void CPU::LD_A_BC() {
-    A = mmu->Read8(GetBC());
+    A = mmu->Read8(BC);
 }
 
 void CPU::LD_A_DE() {
-    A = mmu->Read8(GetDE());
+    A = mmu->Read8(DE);
 }
 
 void CPU::LD_BC_A() {
-    mmu->Write8(GetBC(), A);
+    mmu->Write8(BC, A);
 }
 
 void CPU::LD_DE_A() {
-    mmu->Write8(GetDE(), A);
+    mmu->Write8(DE, A);
 }
 
-void CPU::LD_A_nn() {
-    uint16_t addr = Fetch16();
+void CPU::LD_A_nn(uint16_t addr) {
     A = mmu->Read8(addr);
 }
 
-void CPU::LD_nn_A() {
-    uint16_t addr = Fetch16();
+void CPU::LD_nn_A(uint16_t addr) {
     mmu->Write8(addr, A);
 }
 
@@ -444,32 +604,43 @@ void CPU::LD_C_A() {
     mmu->Write8(0xFF00 + C, A);
 }
 
+void CPU::LDH_A_n(uint8_t n) {
+    A = mmu->Read8(0xFF00 + n);
+}
+
+void CPU::LDH_n_A(uint8_t n) {
+    mmu->Write8(0xFF00 + n, A);
+}
+
 void CPU::LD_A_HLinc() {
-    A = mmu->Read8(GetHL());
-    SetHL(GetHL() + 1);
+    A = mmu->Read8(HL);
+    HL++;
 }
 
 void CPU::LD_A_HLdec() {
-    A = mmu->Read8(GetHL());
-    SetHL(GetHL() - 1);
+    A = mmu->Read8(HL);
+    HL--;
 }
 
 void CPU::LD_HLinc_A() {
-    mmu->Write8(GetHL(), A);
-    SetHL(GetHL() + 1);
+    mmu->Write8(HL, A);
+    HL++;
 }
 
 void CPU::LD_HLdec_A() {
-    mmu->Write8(GetHL(), A);
-    SetHL(GetHL() - 1);
+    mmu->Write8(HL, A);
+    HL--;
 }
 
-void CPU::LD_SP_nn() {
-    SP = Fetch16();
+void CPU::LD_SP_nn(uint16_t nn) {
+    SP = nn;
 }
 
-void CPU::LD_HL_SPn() {
-    int8_t n = static_cast<int8_t>(Fetch8());
+void CPU::LD_nn_SP(uint16_t addr) {
+    mmu->Write16(addr, SP);
+}
+
+void CPU::LD_HL_SPn(int8_t n) {
     uint16_t result = SP + n;
     
     SetFlag(FLAG_C, (SP & 0xFF) + n > 0xFF);
@@ -477,61 +648,53 @@ void CPU::LD_HL_SPn() {
     SetFlag(FLAG_Z, false);
     SetFlag(FLAG_N, false);
     
-    SetHL(result);
+    HL = result;
 }
 
 // --- 8-bit INC/DEC (memory) ---
 void CPU::INC_HLmem() {
-    uint16_t addr = GetHL();
+    uint16_t addr = HL;
     uint8_t val = mmu->Read8(addr);
     uint8_t old = val;
     val++;
-    
-    if (val == 0) SetFlag(FLAG_Z, true);
-    else SetFlag(FLAG_Z, false);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, (old & 0x0F) + 1 > 0x0F);
+    RecordFlags(FlagOp::Inc, old, 1, val, CarryFlag() != 0);
     
     mmu->Write8(addr, val);
 }
 
 void CPU::DEC_HLmem() {
-    uint16_t addr = GetHL();
+    uint16_t addr = HL;
     uint8_t val = mmu->Read8(addr);
     uint8_t old = val;
     val--;
-    
-    if (val == 0) SetFlag(FLAG_Z, true);
-    else SetFlag(FLAG_Z, false);
-    SetFlag(FLAG_N, true);
-    SetFlag(FLAG_H, (old & 0x0F) == 0);
+    RecordFlags(FlagOp::Dec, old, 1, val, CarryFlag() != 0);
     
     mmu->Write8(addr, val);
 }
 
 // --- 16-bit INC/DEC ---
 void CPU::INC_BC() {
-    SetBC(GetBC() + 1);
+    BC++;
 }
 
 void CPU::DEC_BC() {
-    SetBC(GetBC() - 1);
+    BC--;
 }
 
 void CPU::INC_DE() {
-    SetDE(GetDE() + 1);
+    DE++;
 }
 
 void CPU::DEC_DE() {
-    SetDE(GetDE() - 1);
+    DE--;
 }
 
 void CPU::INC_HL() {
-    SetHL(GetHL() + 1);
+    HL++;
 }
 
 void CPU::DEC_HL() {
-    SetHL(GetHL() - 1);
+    HL--;
 }
 
 void CPU::INC_SP() {
@@ -544,300 +707,190 @@ void CPU::DEC_SP() {
 
 // --- Arithmetic operations ---
 void CPU::ADD_A_r(uint8_t val) {
-    uint16_t result = A + val;
-    
-    SetFlag(FLAG_Z, (result & 0xFF) == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, (A & 0x0F) + (val & 0x0F) > 0x0F);
-    SetFlag(FLAG_C, result > 0xFF);
-    
-    A = result & 0xFF;
-}
-
-void CPU::ADD_A_n() {
-    ADD_A_r(Fetch8());
-}
-
-void CPU::ADD_A_HL() {
-    ADD_A_r(mmu->Read8(GetHL()));
+    uint8_t result = A + val;
+    RecordFlags(FlagOp::Add, A, val, result, A + val > 0xFF);
+    A = result;
 }
 
 void CPU::ADD_HL_BC() {
-    uint32_t result = GetHL() + GetBC();
+    uint32_t result = HL + BC;
     SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, (GetHL() & 0x0FFF) + (GetBC() & 0x0FFF) > 0x0FFF);
+    SetFlag(FLAG_H, (HL & 0x0FFF) + (BC & 0x0FFF) > 0x0FFF);
     SetFlag(FLAG_C, result > 0xFFFF);
-    SetHL(result & 0xFFFF);
+    HL = static_cast<uint16_t>(result);
 }
 
 void CPU::ADD_HL_DE() {
-    uint32_t result = GetHL() + GetDE();
+    uint32_t result = HL + DE;
     SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, (GetHL() & 0x0FFF) + (GetDE() & 0x0FFF) > 0x0FFF);
+    SetFlag(FLAG_H, (HL & 0x0FFF) + (DE & 0x0FFF) > 0x0FFF);
     SetFlag(FLAG_C, result > 0xFFFF);
-    SetHL(result & 0xFFFF);
+    HL = static_cast<uint16_t>(result);
 }
 
 void CPU::ADD_HL_HL() {
-    uint32_t result = GetHL() + GetHL();
+    uint32_t result = HL + HL;
     SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, (GetHL() & 0x0FFF) + (GetHL() & 0x0FFF) > 0x0FFF);
+    SetFlag(FLAG_H, (HL & 0x0FFF) + (HL & 0x0FFF) > 0x0FFF);
     SetFlag(FLAG_C, result > 0xFFFF);
-    SetHL(result & 0xFFFF);
+    HL = static_cast<uint16_t>(result);
 }
 
 void CPU::ADD_HL_SP() {
-    uint32_t result = GetHL() + SP;
+    uint32_t result = HL + SP;
     SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, (GetHL() & 0x0FFF) + (SP & 0x0FFF) > 0x0FFF);
+    SetFlag(FLAG_H, (HL & 0x0FFF) + (SP & 0x0FFF) > 0x0FFF);
     SetFlag(FLAG_C, result > 0xFFFF);
-    SetHL(result & 0xFFFF);
+    HL = static_cast<uint16_t>(result);
 }
 
-void CPU::ADC_A_r(uint8_t val) {
-    uint8_t carry = GetFlag(FLAG_C) ? 1 : 0;
-    uint16_t result = A + val + carry;
-    
-    SetFlag(FLAG_Z, (result & 0xFF) == 0);
+void CPU::ADD_SP_n(int8_t n) {
+    uint16_t result = SP + n;
+
+    SetFlag(FLAG_C, (SP & 0xFF) + static_cast<uint8_t>(n) > 0xFF);
+    SetFlag(FLAG_H, (SP & 0x0F) + (n & 0x0F) > 0x0F);
+    SetFlag(FLAG_Z, false);
     SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, (A & 0x0F) + (val & 0x0F) + carry > 0x0F);
-    SetFlag(FLAG_C, result > 0xFF);
-    
-    A = result & 0xFF;
-}
 
-void CPU::ADC_A_n() {
-    ADC_A_r(Fetch8());
+    SP = result;
 }
 
-void CPU::ADC_A_HL() {
-    ADC_A_r(mmu->Read8(GetHL()));
+void CPU::ADC_A_r(uint8_t val) {
+    uint8_t carry = GetFlag(FLAG_C) ? 1 : 0;
+    uint8_t result = A + val + carry;
+    RecordFlags(FlagOp::Adc, A, val, result, A + val + carry > 0xFF, carry);
+    A = result;
 }
 
 void CPU::SUB_A_r(uint8_t val) {
     uint8_t result = A - val;
-    
-    SetFlag(FLAG_Z, result == 0);
-    SetFlag(FLAG_N, true);
-    SetFlag(FLAG_H, (A & 0x0F) < (val & 0x0F));
-    SetFlag(FLAG_C, A < val);
-    
+    RecordFlags(FlagOp::Sub, A, val, result, A < val);
     A = result;
 }
 
-void CPU::SUB_A_n() {
-    SUB_A_r(Fetch8());
-}
-
-void CPU::SUB_A_HL() {
-    SUB_A_r(mmu->Read8(GetHL()));
-}
-
 void CPU::SBC_A_r(uint8_t val) {
     uint8_t carry = GetFlag(FLAG_C) ? 1 : 0;
-    uint16_t total = val + carry;
-    uint8_t result = A - total;
-    
-    SetFlag(FLAG_Z, result == 0);
-    SetFlag(FLAG_N, true);
-    SetFlag(FLAG_H, (A & 0x0F) < (total & 0x0F));
-    SetFlag(FLAG_C, A < total);
-    
+    uint8_t result = A - val - carry;
+    RecordFlags(FlagOp::Sbc, A, val, result, A < val + carry, carry);
     A = result;
 }
 
-void CPU::SBC_A_n() {
-    SBC_A_r(Fetch8());
-}
-
-void CPU::SBC_A_HL() {
-    SBC_A_r(mmu->Read8(GetHL()));
-}
-
 void CPU::CP_A_r(uint8_t val) {
-    SetFlag(FLAG_Z, A == val);
-    SetFlag(FLAG_N, true);
-    SetFlag(FLAG_H, (A & 0x0F) < (val & 0x0F));
-    SetFlag(FLAG_C, A < val);
-}
-
-void CPU::CP_A_n() {
-    CP_A_r(Fetch8());
-}
-
-void CPU::CP_A_HL() {
-    CP_A_r(mmu->Read8(GetHL()));
+    RecordFlags(FlagOp::Sub, A, val, static_cast<uint8_t>(A - val), A < val);
 }
 
 // --- Logical operations ---
 void CPU::AND_A_r(uint8_t val) {
     A &= val;
-    
-    SetFlag(FLAG_Z, A == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, true);
-    SetFlag(FLAG_C, false);
-}
-
-void CPU::AND_A_n() {
-    AND_A_r(Fetch8());
-}
-
-void CPU::AND_A_HL() {
-    AND_A_r(mmu->Read8(GetHL()));
+    RecordFlags(FlagOp::Bits, 0, 0, A, false, 1 << FLAG_H);
 }
 
 void CPU::OR_A_r(uint8_t val) {
     A |= val;
-    
-    SetFlag(FLAG_Z, A == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, false);
-}
-
-void CPU::OR_A_n() {
-    OR_A_r(Fetch8());
-}
-
-void CPU::OR_A_HL() {
-    OR_A_r(mmu->Read8(GetHL()));
+    RecordFlags(FlagOp::Bits, 0, 0, A, false);
 }
 
 void CPU::XOR_A_r(uint8_t val) {
     A ^= val;
-    
-    SetFlag(FLAG_Z, A == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, false);
-}
-
-void CPU::XOR_A_n() {
-    XOR_A_r(Fetch8());
-}
-
-void CPU::XOR_A_HL() {
-    XOR_A_r(mmu->Read8(GetHL()));
+    RecordFlags(FlagOp::Bits, 0, 0, A, false);
 }
 
 // --- Rotates and shifts ---
 void CPU::RLC_A() {
     bool carry = (A & 0x80) != 0;
     A = (A << 1) | (carry ? 1 : 0);
-    
-    SetFlag(FLAG_Z, A == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, carry);
+    RecordFlags(FlagOp::Bits, 0, 0, A, carry);
 }
 
 void CPU::RRC_A() {
     bool carry = (A & 0x01) != 0;
     A = (A >> 1) | (carry ? 0x80 : 0);
-    
-    SetFlag(FLAG_Z, A == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, carry);
+    RecordFlags(FlagOp::Bits, 0, 0, A, carry);
 }
 
 void CPU::RL_A() {
     bool carry = GetFlag(FLAG_C);
     bool newCarry = (A & 0x80) != 0;
     A = (A << 1) | (carry ? 1 : 0);
-    
-    SetFlag(FLAG_Z, A == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, newCarry);
+    RecordFlags(FlagOp::Bits, 0, 0, A, newCarry);
 }
 
 void CPU::RR_A() {
     bool carry = GetFlag(FLAG_C);
     bool newCarry = (A & 0x01) != 0;
     A = (A >> 1) | (carry ? 0x80 : 0);
-    
-    SetFlag(FLAG_Z, A == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, newCarry);
+    RecordFlags(FlagOp::Bits, 0, 0, A, newCarry);
 }
 
-void CPU::SLA_r(uint8_t& reg) {
+void CPU::RLC_r(uint8_t& reg) {
     bool carry = (reg & 0x80) != 0;
-    reg <<= 1;
-    
-    SetFlag(FLAG_Z, reg == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, carry);
+    reg = (reg << 1) | (carry ? 1 : 0);
+    RecordFlags(FlagOp::Bits, 0, 0, reg, carry);
 }
 
-void CPU::SRA_r(uint8_t& reg) {
+void CPU::RRC_r(uint8_t& reg) {
     bool carry = (reg & 0x01) != 0;
-    bool msb = (reg & 0x80) != 0;
-    reg = (reg >> 1) | (msb ? 0x80 : 0);
-    
-    SetFlag(FLAG_Z, reg == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, carry);
+    reg = (reg >> 1) | (carry ? 0x80 : 0);
+    RecordFlags(FlagOp::Bits, 0, 0, reg, carry);
 }
 
-void CPU::SRL_r(uint8_t& reg) {
-    bool carry = (reg & 0x01) != 0;
-    reg >>= 1;
-    
-    SetFlag(FLAG_Z, reg == 0);
-    SetFlag(FLAG_N, false);
-    SetFlag(FLAG_H, false);
-    SetFlag(FLAG_C, carry);
+void CPU::RL_r(uint8_t& reg) {
+    bool carry = GetFlag(FLAG_C);
+    bool newCarry = (reg & 0x80) != 0;
+    reg = (reg << 1) | (carry ? 1 : 0);
+    RecordFlags(FlagOp::Bits, 0, 0, reg, newCarry);
 }
 
-// --- Jump instructions ---
-void CPU::JP_NZ(uint16_t addr) {
-    if (!GetFlag(FLAG_Z)) PC = addr;
+void CPU::RR_r(uint8_t& reg) {
+    bool carry = GetFlag(FLAG_C);
+    bool newCarry = (reg & 0x01) != 0;
+    reg = (reg >> 1) | (carry ? 0x80 : 0);
+    RecordFlags(FlagOp::Bits, 0, 0, reg, newCarry);
 }
 
-void CPU::JP_Z(uint16_t addr) {
-    if (GetFlag(FLAG_Z)) PC = addr;
+void CPU::SLA_r(uint8_t& reg) {
+    bool carry = (reg & 0x80) != 0;
+    reg <<= 1;
+    RecordFlags(FlagOp::Bits, 0, 0, reg, carry);
 }
 
-void CPU::JP_NC(uint16_t addr) {
-    if (!GetFlag(FLAG_C)) PC = addr;
+void CPU::SRA_r(uint8_t& reg) {
+    bool carry = (reg & 0x01) != 0;
+    bool msb = (reg & 0x80) != 0;
+    reg = (reg >> 1) | (msb ? 0x80 : 0);
+    RecordFlags(FlagOp::Bits, 0, 0, reg, carry);
 }
 
-void CPU::JP_C(uint16_t addr) {
-    if (GetFlag(FLAG_C)) PC = addr;
+void CPU::SWAP_r(uint8_t& reg) {
+    reg = (reg << 4) | (reg >> 4);
+    RecordFlags(FlagOp::Bits, 0, 0, reg, false);
 }
 
-void CPU::JR(int8_t offset) {
-    PC += offset;
+void CPU::SRL_r(uint8_t& reg) {
+    bool carry = (reg & 0x01) != 0;
+    reg >>= 1;
+    RecordFlags(FlagOp::Bits, 0, 0, reg, carry);
 }
 
-void CPU::JR_NZ(int8_t offset) {
-    if (!GetFlag(FLAG_Z)) {
-        PC += offset;
-    }
+// --- Bit operations (CB page) ---
+template<int BIT>
+void CPU::BIT_b(uint8_t val) {
+    RecordFlags(FlagOp::Bits, 0, 0, val & (1 << BIT), CarryFlag() != 0, 1 << FLAG_H);
 }
 
-void CPU::JR_Z(int8_t offset) {
-    if (GetFlag(FLAG_Z)) {
-        PC += offset;
-    }
+template<int BIT>
+void CPU::RES_b(uint8_t& val) {
+    val &= ~(1 << BIT);
 }
 
-void CPU::JR_NC(int8_t offset) {
-    if (!GetFlag(FLAG_C)) {
-        PC += offset;
-    }
+template<int BIT>
+void CPU::SET_b(uint8_t& val) {
+    val |= (1 << BIT);
 }
 
-void CPU::JR_C(int8_t offset) {
-    if (GetFlag(FLAG_C)) {
-        PC += offset;
-    }
+// --- Jump instructions ---
+void CPU::JR(int8_t offset) {
+    PC += offset;
 }
 
 // --- Call and return instructions ---
@@ -847,62 +900,18 @@ void CPU::CALL(uint16_t addr) {
     PC = addr;
 }
 
-void CPU::CALL_NZ(uint16_t addr) {
-    if (!GetFlag(FLAG_Z)) {
-        CALL(addr);
-    }
-}
-
-void CPU::CALL_Z(uint16_t addr) {
-    if (GetFlag(FLAG_Z)) {
-        CALL(addr);
-    }
-}
-
-void CPU::CALL_NC(uint16_t addr) {
-    if (!GetFlag(FLAG_C)) {
-        CALL(addr);
-    }
-}
-
-void CPU::CALL_C(uint16_t addr) {
-    if (GetFlag(FLAG_C)) {
-        CALL(addr);
-    }
-}
-
 void CPU::RET() {
     PC = mmu->Read16(SP);
     SP += 2;
 }
 
-void CPU::RET_NZ() {
-    if (!GetFlag(FLAG_Z)) {
-        RET();
-    }
-}
-
-void CPU::RET_Z() {
-    if (GetFlag(FLAG_Z)) {
-        RET();
-    }
-}
-
-void CPU::RET_NC() {
-    if (!GetFlag(FLAG_C)) {
-        RET();
-    }
-}
-
-void CPU::RET_C() {
-    if (GetFlag(FLAG_C)) {
-        RET();
-    }
-}
-
 void CPU::RETI() {
     RET();
-    // TODO: Enable interrupts
+    interrupts->Enable();
+}
+
+void CPU::RST(uint16_t vector) {
+    CALL(vector);
 }
 
 // --- Stack operations ---
@@ -913,17 +922,17 @@ void CPU::PUSH_AF() {
 
 void CPU::PUSH_BC() {
     SP -= 2;
-    mmu->Write16(SP, GetBC());
+    mmu->Write16(SP, BC);
 }
 
 void CPU::PUSH_DE() {
     SP -= 2;
-    mmu->Write16(SP, GetDE());
+    mmu->Write16(SP, DE);
 }
 
 void CPU::PUSH_HL() {
     SP -= 2;
-    mmu->Write16(SP, GetHL());
+    mmu->Write16(SP, HL);
 }
 
 void CPU::POP_AF() {
@@ -932,35 +941,37 @@ void CPU::POP_AF() {
 }
 
 void CPU::POP_BC() {
-    SetBC(mmu->Read16(SP));
+    BC = mmu->Read16(SP);
     SP += 2;
 }
 
 void CPU::POP_DE() {
-    SetDE(mmu->Read16(SP));
+    DE = mmu->Read16(SP);
     SP += 2;
 }
 
 void CPU::POP_HL() {
-    SetHL(mmu->Read16(SP));
+    HL = mmu->Read16(SP);
     SP += 2;
 }
 
 // --- Miscellaneous instructions ---
 void CPU::HALT() {
-    // TODO: Implement halt state
+    interrupts->Halt(false);
 }
 
 void CPU::STOP() {
-    // TODO: Implement stop state
+    // Also resets DIV; the LCD and timer would stop as well, which is not modelled
+    interrupts->Halt(true);
+    mmu->Write8(0xFF04, 0);
 }
 
 void CPU::DI() {
-    // TODO: Disable interrupts
+    interrupts->Disable();
 }
 
 void CPU::EI() {
-    // TODO: Enable interrupts
+    interrupts->EnableAfterNext();
 }
 
 void CPU::CPL() {
@@ -981,6 +992,10 @@ void CPU::CCF() {
     SetFlag(FLAG_C, !GetFlag(FLAG_C));
 }
 
+void CPU::Unimplemented(uint8_t opcode) {
+    SDL_Log("Unimplemented opcode: 0x%02X at PC=%04X", opcode, PC - kOpcodeTable[opcode].length);
+}
+
 void CPU::DAA() {
     // Decimal Adjust Accumulator
     uint8_t correction = 0;
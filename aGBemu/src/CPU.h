@@ -1,26 +1,125 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
+#include <array>
+#include <memory>
+#include <utility>
 
 class MMU;
+class BlockCache;
+class Jit;
+class FlagCheck;
+class Scheduler;
+class IdleLoopDetector;
+class Interrupts;
 
 class CPU
 {
 public:
     CPU(MMU* mmu);
+    ~CPU();
 
     void Reset();
-    int Step();            // Execute a single instruction, return cycles
-    void RunCycles(int n); // Optional: execute n cycles
+    int Step();            // Execute a single instruction (or cached block), return cycles
 
-    // --- NEW: expose only registers A and B for debug UI ---
-    uint8_t GetA() const { return A; }
-    uint8_t GetB() const { return B; }
+    // Execute until the scheduler clock reaches `deadline` or a device
+    // requests a break. Returns Now() - deadline: the overshoot of the last
+    // instruction, for the caller to carry into the next burst, or a
+    // negative value when the burst was broken off early.
+    int64_t RunUntil(uint64_t deadline);
+
+    // Pre-decoded block execution; off runs the plain interpreter
+    void SetBlockCacheEnabled(bool enabled);
+    bool IsBlockCacheEnabled() const { return blockCache != nullptr; }
+
+    // x86-64 translation of hot ROM blocks (implies the block cache)
+    void SetJitEnabled(bool enabled);
+    bool IsJitEnabled() const { return jit != nullptr; }
+
+    // Skip iterations of loops that only poll for a scheduled event
+    void SetIdleLoopSkipEnabled(bool enabled);
+    bool IsIdleLoopSkipEnabled() const { return idleLoops != nullptr; }
+    uint64_t GetIdleSkippedCycles() const; // since the last Reset()
+
+    bool IsHalted() const;
+    bool IsStopped() const;
+
+    // Read-only copy of the register file for the debugger
+    struct Registers {
+        uint8_t A, F, B, C, D, E, H, L;
+        uint16_t AF, BC, DE, HL, SP, PC;
+    };
+    Registers GetRegisters() const;
 
 private:
+    friend class Jit; // addresses register fields from generated code
+    friend class FlagCheck; // steps with the flags materialized after every instruction (AluBenchmark.cpp)
+
     MMU* mmu;
+    Scheduler* scheduler; // owned by the MMU
+    Interrupts* interrupts; // owned by the MMU
+    std::unique_ptr<BlockCache> blockCache;
+    std::unique_ptr<Jit> jit;
+    std::unique_ptr<IdleLoopDetector> idleLoops;
+
+    // Opcode dispatch: one handler per opcode, generated at compile time from
+    // kOpcodeTable (see Opcodes.h). Each handler fetches its own operand bytes
+    // and returns the cycles the instruction took.
+    using OpHandler = int (*)(CPU&);
+    static const std::array<OpHandler, 256> dispatchTable;
+    static const std::array<OpHandler, 256> cbDispatchTable;
+
+    // Same bodies with the operand supplied by the block decoder
+    using DecodedHandler = int (*)(CPU&, uint16_t);
+    static const std::array<DecodedHandler, 256> decodedTable;
+
+    template<uint8_t OP> static int Dispatch(CPU& cpu);
+    template<uint8_t OP> static int DispatchDecoded(CPU& cpu, uint16_t operand);
+    template<uint8_t OP> int Execute(uint16_t operand);
+    template<size_t... OPS> static constexpr auto MakeDispatchTable(std::index_sequence<OPS...>);
+    template<size_t... OPS> static constexpr auto MakeDecodedTable(std::index_sequence<OPS...>);
+    int StepBlock();
+    static constexpr int kChainCycles = 456; // one scanline; bounds a self-loop run by Step()
 
-    // 8-bit registers
-    uint8_t A, F, B, C, D, E, H, L;
+    // HALT/STOP: no instructions run until an interrupt is requested, so the
+    // clock jumps to the next scheduled event instead of idling 4 cycles at
+    // a time. With nothing scheduled it idles in chunks of kIdleChunk.
+    static constexpr uint32_t kIdleChunk = 70224; // one frame
+    int FastForward();
+
+    // Runs when Interrupts::NeedsService() is set: HALT wake-up, the EI
+    // delay and interrupt dispatch. Returns the cycles it used, or 0 when
+    // the next instruction should run as usual.
+    int Service();
+
+    // Taken jump back to PC from `end`; adds the cycles of any skipped idle iterations
+    int BackwardJump(uint16_t end, int cycles);
+
+    // CB page: one instantiation per (operation, bit, register) combination
+    template<uint8_t CB> static int DispatchCB(CPU& cpu);
+    template<size_t... OPS> static constexpr auto MakeCBDispatchTable(std::index_sequence<OPS...>);
+
+    // Register operand as encoded in opcode bits: B,C,D,E,H,L,(HL),A
+    template<int R> uint8_t& Reg8();
+    template<int R> uint8_t ReadOperand8();
+    template<int R> void WriteOperand8(uint8_t val);
+    template<int OPN> void ALU(uint8_t val);
+    template<int OPN> void Shift(uint8_t& val);
+
+    // Register file: each pair is one uint16_t, with the 8-bit halves
+    // overlaid in host byte order so both views are plain loads/stores.
+    // The F half is only current while flagOp is None; read AF via GetAF().
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    union { uint16_t AF; struct { uint8_t A, F; }; };
+    union { uint16_t BC; struct { uint8_t B, C; }; };
+    union { uint16_t DE; struct { uint8_t D, E; }; };
+    union { uint16_t HL; struct { uint8_t H, L; }; };
+#else
+    union { uint16_t AF; struct { uint8_t F, A; }; };
+    union { uint16_t BC; struct { uint8_t C, B; }; };
+    union { uint16_t DE; struct { uint8_t E, D; }; };
+    union { uint16_t HL; struct { uint8_t L, H; }; };
+#endif
 
     // 16-bit registers
     uint16_t SP; // Stack pointer
@@ -34,37 +133,64 @@ private:
         FLAG_C = 4   // Carry
     };
 
-    // Helpers
+    // Lazy flags: ALU helpers record the last operation and its operands, and
+    // Z/N/H/C are only computed when something reads F (conditional branch,
+    // PUSH AF, DAA, ADC/SBC, debugger). While flagOp is None, F is current.
+    // Build with GBEMU_EAGER_FLAGS to materialize after every operation.
+#ifdef GBEMU_EAGER_FLAGS
+    static constexpr bool kLazyFlags = false;
+#else
+    static constexpr bool kLazyFlags = true;
+#endif
+    enum class FlagOp : uint8_t {
+        None, // F holds the flags
+        Add,  // H from flagA + flagB
+        Adc,  // H from flagA + flagB + carry-in (flagBits)
+        Sub,  // H from flagA - flagB (also CP)
+        Sbc,  // H from flagA - flagB - carry-in (flagBits)
+        Inc,  // H from flagA + 1
+        Dec,  // H from flagA - 1
+        Bits  // N/H given in flagBits (logic, rotates, shifts, BIT)
+    };
+    // Z is always flagRes == 0 and C is always flagCarry; both are cheap to
+    // produce eagerly and are what branches and ADC/SBC/INC/DEC need
+    FlagOp flagOp = FlagOp::None;
+    uint8_t flagA = 0, flagB = 0, flagRes = 0, flagBits = 0;
+    uint8_t flagCarry = 0; // 0 or 1 << FLAG_C
+
+    void RecordFlags(FlagOp op, uint8_t a, uint8_t b, uint8_t res, bool carry, uint8_t bits = 0);
+    uint8_t ComputeFlags() const;
+    uint8_t CarryFlag() const { return flagOp == FlagOp::None ? (F & (1 << FLAG_C)) : flagCarry; }
+    void MaterializeFlags();
+
+    // AF goes through the flag logic; the other pairs are accessed directly
     uint16_t GetAF();
-    uint16_t GetBC();
-    uint16_t GetDE();
-    uint16_t GetHL();
     void SetAF(uint16_t val);
-    void SetBC(uint16_t val);
-    void SetDE(uint16_t val);
-    void SetHL(uint16_t val);
 
     // Instruction implementations
     void NOP();
-    void LD_r_n(uint8_t& reg);
+    void LD_r_n(uint8_t& reg, uint8_t n);
     void LD_r_r(uint8_t& dest, uint8_t src);
     void LD_r_HL(uint8_t& reg);
     void LD_HL_r(uint8_t reg);
-    void LD_HL_n();
+    void LD_HL_n(uint8_t n);
     void LD_A_BC();
     void LD_A_DE();
     void LD_BC_A();
     void LD_DE_A();
-    void LD_A_nn();
-    void LD_nn_A();
+    void LD_A_nn(uint16_t addr);
+    void LD_nn_A(uint16_t addr);
     void LD_A_C();
     void LD_C_A();
+    void LDH_A_n(uint8_t n);
+    void LDH_n_A(uint8_t n);
     void LD_A_HLdec();
     void LD_A_HLinc();
     void LD_HLdec_A();
     void LD_HLinc_A();
-    void LD_SP_nn();
-    void LD_HL_SPn();
+    void LD_SP_nn(uint16_t nn);
+    void LD_nn_SP(uint16_t addr);
+    void LD_HL_SPn(int8_t n);
     
     // 8-bit INC/DEC
     void INC_r(uint8_t& reg);
@@ -84,69 +210,49 @@ private:
     
     // Arithmetic
     void ADD_A_r(uint8_t val);
-    void ADD_A_n();
-    void ADD_A_HL();
     void ADD_HL_BC();
     void ADD_HL_DE();
     void ADD_HL_HL();
     void ADD_HL_SP();
+    void ADD_SP_n(int8_t n);
     void ADC_A_r(uint8_t val);
-    void ADC_A_n();
-    void ADC_A_HL();
     void SUB_A_r(uint8_t val);
-    void SUB_A_n();
-    void SUB_A_HL();
     void SBC_A_r(uint8_t val);
-    void SBC_A_n();
-    void SBC_A_HL();
     void CP_A_r(uint8_t val);
-    void CP_A_n();
-    void CP_A_HL();
     
     // Logical
     void AND_A_r(uint8_t val);
-    void AND_A_n();
-    void AND_A_HL();
     void OR_A_r(uint8_t val);
-    void OR_A_n();
-    void OR_A_HL();
     void XOR_A_r(uint8_t val);
-    void XOR_A_n();
-    void XOR_A_HL();
     
     // Rotates and shifts
     void RLC_A();
     void RRC_A();
     void RL_A();
     void RR_A();
+    void RLC_r(uint8_t& reg);
+    void RRC_r(uint8_t& reg);
+    void RL_r(uint8_t& reg);
+    void RR_r(uint8_t& reg);
     void SLA_r(uint8_t& reg);
     void SRA_r(uint8_t& reg);
+    void SWAP_r(uint8_t& reg);
     void SRL_r(uint8_t& reg);
+
+    // Bit operations (CB page); the bit index is a template parameter
+    template<int BIT> void BIT_b(uint8_t val);
+    template<int BIT> void RES_b(uint8_t& val);
+    template<int BIT> void SET_b(uint8_t& val);
     
-    // Jumps
+    // Jumps (conditional forms test CheckCondition() in the dispatcher)
     void JP(uint16_t addr);
-    void JP_NZ(uint16_t addr);
-    void JP_Z(uint16_t addr);
-    void JP_NC(uint16_t addr);
-    void JP_C(uint16_t addr);
     void JR(int8_t offset);
-    void JR_NZ(int8_t offset);
-    void JR_Z(int8_t offset);
-    void JR_NC(int8_t offset);
-    void JR_C(int8_t offset);
     
     // Calls and returns
     void CALL(uint16_t addr);
-    void CALL_NZ(uint16_t addr);
-    void CALL_Z(uint16_t addr);
-    void CALL_NC(uint16_t addr);
-    void CALL_C(uint16_t addr);
     void RET();
-    void RET_NZ();
-    void RET_Z();
-    void RET_NC();
-    void RET_C();
     void RETI();
+    void RST(uint16_t vector);
     
     // Stack operations
     void PUSH_AF();
@@ -167,6 +273,7 @@ private:
     void SCF();
     void CCF();
     void DAA();
+    void Unimplemented(uint8_t opcode);
 
     // Fetch helpers
     uint8_t Fetch8();
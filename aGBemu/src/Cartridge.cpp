@@ -0,0 +1,299 @@
+#include "Cartridge.h"
+#include "Scheduler.h"
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+Cartridge::Cartridge()
+{
+    static const std::shared_ptr<const RomImage> blank = RomImage::FromBytes(std::vector<uint8_t>(2 * kROMBankSize, 0));
+    image = blank;
+    rom = image->Data();
+}
+
+Cartridge::~Cartridge()
+{
+    DetachSave();
+}
+
+uint64_t Cartridge::Now() const
+{
+    return scheduler ? scheduler->Now() : 0;
+}
+
+void Cartridge::Load(std::shared_ptr<const RomImage> newImage)
+{
+    const uint8_t* data = newImage->Data();
+    const size_t size = newImage->Size();
+    const uint8_t type = size > 0x0147 ? data[0x0147] : 0;
+    const uint8_t romSizeCode = size > 0x0148 ? data[0x0148] : 0;
+    const uint8_t ramSizeCode = size > 0x0149 ? data[0x0149] : 0;
+
+    DetachSave();
+
+    battery = rtc = false;
+    switch (type)
+    {
+    case 0x00: mbc = MBC::None; break;
+    case 0x08: mbc = MBC::None; break;
+    case 0x09: mbc = MBC::None; battery = true; break;
+    case 0x01:
+    case 0x02: mbc = MBC::MBC1; break;
+    case 0x03: mbc = MBC::MBC1; battery = true; break;
+    case 0x05: mbc = MBC::MBC2; break;
+    case 0x06: mbc = MBC::MBC2; battery = true; break;
+    case 0x0F:
+    case 0x10: mbc = MBC::MBC3; battery = rtc = true; break;
+    case 0x11:
+    case 0x12: mbc = MBC::MBC3; break;
+    case 0x13: mbc = MBC::MBC3; battery = true; break;
+    case 0x19:
+    case 0x1A:
+    case 0x1C:
+    case 0x1D: mbc = MBC::MBC5; break;
+    case 0x1B:
+    case 0x1E: mbc = MBC::MBC5; battery = true; break;
+    default:
+        std::cerr << "Warning: unsupported cartridge type 0x" << std::hex << int(type) << std::dec
+                  << "; running it without a bank controller." << std::endl;
+        mbc = MBC::None;
+        break;
+    }
+
+    // Whole banks, a power of two of them, covering both the header's size
+    // and the file; missing data reads as open bus. Well-formed dumps are
+    // used as they are, anything else is padded into a copy (which is
+    // itself shared with other cartridges padding the same dump).
+    size_t banks = romSizeCode <= 8 ? size_t(2) << romSizeCode : 2;
+    while (banks * kROMBankSize < size)
+        banks *= 2;
+    if (size != banks * kROMBankSize)
+    {
+        std::vector<uint8_t> padded(banks * kROMBankSize, 0xFF);
+        std::memcpy(padded.data(), data, size);
+        newImage = RomImage::FromBytes(std::move(padded));
+    }
+    image = std::move(newImage);
+    rom = image->Data();
+    romBankCount = static_cast<uint16_t>(banks);
+
+    static const uint8_t ramBanksBySize[] = { 0, 1, 1, 4, 16, 8 }; // 2 KB is given a full bank
+    ramBankCount = ramSizeCode < sizeof(ramBanksBySize) ? ramBanksBySize[ramSizeCode] : 0;
+    if (mbc == MBC::MBC2)
+        ram.assign(512, 0); // 512 x 4 bits, built into the controller
+    else
+        ram.assign(ramBankCount * kRAMBankSize, 0);
+    rtcClock.Reset(Now());
+
+    Reset();
+}
+
+bool Cartridge::AttachSave(const std::string& path)
+{
+    if (battery && !ram.empty())
+    {
+        save = SaveFile::Open(path, ram.size());
+        if (save)
+        {
+            std::memcpy(ram.data(), save->Data(), ram.size());
+            if (mbc == MBC::MBC2)
+                for (uint8_t& nibble : ram)
+                    nibble &= 0x0F;
+        }
+    }
+    if (rtc)
+    {
+        // game.sav -> game.rtc; a new file holds no clock and starts at day 0
+        const bool isSav = path.size() > 4 && path.compare(path.size() - 4, 4, ".sav") == 0;
+        rtcSave = SaveFile::Open((isSav ? path.substr(0, path.size() - 4) : path) + ".rtc", SaveFile::kPageSize);
+        if (rtcSave)
+        {
+            RealTimeClock::State state;
+            std::memcpy(&state, rtcSave->Data(), sizeof(state));
+            rtcClock.Load(state, Now());
+        }
+    }
+    dirtyPages.reset();
+    rtcDirty = false;
+    return save || rtcSave;
+}
+
+bool Cartridge::FlushSave()
+{
+    const bool ramDirty = save && dirtyPages.any();
+
+    // The clock is saved with every RAM save as well, so that the wall-clock
+    // time it catches up on after a crash is never older than the game's save
+    if (rtcSave && (rtcDirty || ramDirty))
+    {
+        std::vector<SaveFile::Page> pages(1);
+        pages[0].offset = 0;
+        std::memset(pages[0].data, 0, SaveFile::kPageSize);
+        const RealTimeClock::State state = rtcClock.Save(Now());
+        std::memcpy(pages[0].data, &state, sizeof(state));
+        rtcSave->Commit(std::move(pages));
+    }
+    rtcDirty = false;
+
+    if (!ramDirty)
+        return false;
+    std::vector<SaveFile::Page> pages;
+    pages.reserve(dirtyPages.count());
+    for (size_t i = 0; i < ram.size() / SaveFile::kPageSize; i++)
+    {
+        if (!dirtyPages[i])
+            continue;
+        SaveFile::Page& page = pages.emplace_back();
+        page.offset = static_cast<uint32_t>(i * SaveFile::kPageSize);
+        std::memcpy(page.data, &ram[page.offset], SaveFile::kPageSize);
+    }
+    dirtyPages.reset();
+    save->Commit(std::move(pages));
+    return true;
+}
+
+// Write out everything still pending (the save files wait for it when they
+// close) and let go of the files
+void Cartridge::DetachSave()
+{
+    rtcDirty = rtcSave != nullptr;
+    FlushSave();
+    save.reset();
+    rtcSave.reset();
+}
+
+void Cartridge::Reset()
+{
+    ramEnabled = false;
+    romBankReg = 1;
+    upperReg = 0;
+    mode = false;
+    latchReg = 0xFF;
+    UpdateBanks();
+}
+
+uint8_t* Cartridge::GetMappedRAM()
+{
+    if (!ramEnabled || mbc == MBC::MBC2 || RTCSelected() || ramBankCount == 0)
+        return nullptr;
+    return &ram[ramBank * kRAMBankSize];
+}
+
+uint8_t Cartridge::WriteControl(uint16_t addr, uint8_t value)
+{
+    const uint8_t* ramBefore = GetMappedRAM();
+    switch (mbc)
+    {
+    case MBC::None:
+        return 0;
+
+    case MBC::MBC1:
+        if (addr < 0x2000) ramEnabled = (value & 0x0F) == 0x0A;
+        else if (addr < 0x4000) romBankReg = (value & 0x1F) ? (value & 0x1F) : 1;
+        else if (addr < 0x6000) upperReg = value & 0x03;
+        else mode = value & 0x01;
+        break;
+
+    case MBC::MBC2:
+        // Address bit 8 selects between RAM enable and ROM bank
+        if (addr >= 0x4000) return 0;
+        if (addr & 0x0100) romBankReg = (value & 0x0F) ? (value & 0x0F) : 1;
+        else ramEnabled = (value & 0x0F) == 0x0A;
+        break;
+
+    case MBC::MBC3:
+        if (addr < 0x2000) ramEnabled = (value & 0x0F) == 0x0A;
+        else if (addr < 0x4000) romBankReg = (value & 0x7F) ? (value & 0x7F) : 1;
+        else if (addr < 0x6000) upperReg = value & 0x0F;
+        else
+        {
+            // Writing 0 then 1 copies the clock into the readable registers
+            if (latchReg == 0x00 && value == 0x01)
+                rtcClock.Latch(Now());
+            latchReg = value;
+            return 0;
+        }
+        break;
+
+    case MBC::MBC5:
+        if (addr < 0x2000) ramEnabled = (value & 0x0F) == 0x0A;
+        else if (addr < 0x3000) romBankReg = (romBankReg & 0x100) | value;
+        else if (addr < 0x4000) romBankReg = (romBankReg & 0xFF) | ((value & 0x01) << 8);
+        else if (addr < 0x6000) upperReg = value & 0x0F;
+        else return 0;
+        break;
+    }
+    uint8_t changed = UpdateBanks();
+    if (GetMappedRAM() != ramBefore)
+        changed |= MAP_RAM;
+    return changed;
+}
+
+// Resolve the registers into bank numbers; returns the MapChange bits of those that moved
+uint8_t Cartridge::UpdateBanks()
+{
+    const uint16_t romMask = romBankCount - 1;
+    const uint8_t ramMask = ramBankCount ? ramBankCount - 1 : 0;
+    uint16_t newBank0 = 0, newBankX = romBankReg;
+    uint8_t newRamBank = 0;
+
+    switch (mbc)
+    {
+    case MBC::None:
+        newBankX = 1;
+        break;
+    case MBC::MBC1:
+        newBankX = static_cast<uint16_t>((upperReg << 5) | romBankReg);
+        if (mode)
+        {
+            newBank0 = static_cast<uint16_t>(upperReg << 5);
+            newRamBank = upperReg;
+        }
+        break;
+    case MBC::MBC2:
+        break;
+    case MBC::MBC3:
+    case MBC::MBC5:
+        newRamBank = upperReg;
+        break;
+    }
+
+    newBank0 &= romMask;
+    newBankX &= romMask;
+    newRamBank &= ramMask;
+    const uint8_t changed = (newBank0 != bank0 ? MAP_ROM0 : 0) | (newBankX != bankX ? MAP_ROMX : 0) |
+                            (newRamBank != ramBank ? MAP_RAM : 0);
+    bank0 = newBank0;
+    bankX = newBankX;
+    ramBank = newRamBank;
+    return changed;
+}
+
+uint8_t Cartridge::ReadRAM(uint16_t addr) const
+{
+    if (!ramEnabled)
+        return 0xFF;
+    if (RTCSelected())
+        return rtcClock.Read(upperReg - 0x08);
+    if (ram.empty())
+        return 0xFF;
+    return mbc == MBC::MBC2 ? ram[addr & 0x01FF] | 0xF0 : ram[RAMOffset(addr)];
+}
+
+void Cartridge::WriteRAM(uint16_t addr, uint8_t value)
+{
+    if (!ramEnabled)
+        return;
+    if (RTCSelected())
+    {
+        rtcClock.Write(Now(), upperReg - 0x08, value);
+        rtcDirty = rtcSave != nullptr;
+        return;
+    }
+    if (ram.empty())
+        return;
+    const size_t offset = RAMOffset(addr);
+    ram[offset] = mbc == MBC::MBC2 ? (value & 0x0F) : value;
+    if (save)
+        dirtyPages[offset >> 8] = true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "RealTimeClock.h"
+#include "RomImage.h"
+#include "SaveFile.h"
+
+class Scheduler;
+
+// Cartridge ROM/RAM and its memory bank controller. Bank registers only
+// decide which slices of the image are visible; the MMU maps those slices
+// straight into its page table, so a bank switch repoints pages instead of
+// copying data. The ROM itself is a shared, read-only RomImage, so
+// cartridges running the same game all point at the same memory.
+class Cartridge
+{
+public:
+    enum class MBC : uint8_t { None, MBC1, MBC2, MBC3, MBC5 };
+
+    Cartridge();
+    ~Cartridge();
+
+    // Take a ROM image and configure the controller from its header
+    // (0x0147 type, 0x0148 ROM size, 0x0149 RAM size)
+    void Load(std::shared_ptr<const RomImage> image);
+
+    // Power-on bank registers
+    void Reset();
+
+    // Emulated time, for the MBC3 clock
+    void SetScheduler(const Scheduler* clockSource) { scheduler = clockSource; }
+    void SuspendClock() { rtcClock.Suspend(Now()); }
+    void ResumeClock() { rtcClock.Resume(Now()); }
+
+    // Battery-backed RAM: load it from a .sav file and keep that file up to
+    // date through FlushSave(). The MBC3 clock is kept in a .rtc file next
+    // to it. False if there is nothing to save or no file could be opened.
+    bool AttachSave(const std::string& path);
+    bool HasSave() const { return save != nullptr; }
+
+    // Dirty tracking for the attached save, per 256-byte page. The MMU keeps
+    // clean pages write-protected so their first write comes through
+    // WriteRAM and marks them.
+    bool HasUnsavedChanges() const { return rtcDirty || dirtyPages.any(); }
+    bool IsRAMPageDirty(uint16_t addr) const { return dirtyPages[RAMOffset(addr) >> 8]; }
+
+    // Hand snapshots of the dirty pages (and the clock) to the save files
+    // and mark them clean; false if no RAM page had to be written
+    bool FlushSave();
+
+    MBC GetMBC() const { return mbc; }
+    bool HasBattery() const { return battery; }
+    bool HasRTC() const { return rtc; }
+    size_t GetROMSize() const { return image->Size(); }
+    const RomImage& GetImage() const { return *image; }
+    size_t GetRAMSize() const { return ram.size(); }
+
+    // Current mapping. ROM slices are 16 KB (0x0000-0x3FFF, 0x4000-0x7FFF);
+    // RAM is the 8 KB at 0xA000, or nullptr when that range has to go
+    // through ReadRAM/WriteRAM (disabled, MBC2 nibble RAM, RTC registers).
+    const uint8_t* GetROMBank0() const { return rom + bank0 * kROMBankSize; }
+    const uint8_t* GetROMBankX() const { return rom + bankX * kROMBankSize; }
+    uint8_t* GetMappedRAM();
+    uint16_t GetBankNumber(uint16_t addr) const { return addr < 0x4000 ? bank0 : bankX; }
+
+    // Which of the mapped ranges a register write moved
+    enum MapChange : uint8_t { MAP_ROM0 = 1, MAP_ROMX = 2, MAP_RAM = 4, MAP_ALL = 7 };
+
+    // Write to 0x0000-0x7FFF; returns the MapChange bits of what moved
+    uint8_t WriteControl(uint16_t addr, uint8_t value);
+
+    // 0xA000-0xBFFF accesses that are not directly mapped
+    uint8_t ReadRAM(uint16_t addr) const;
+    void WriteRAM(uint16_t addr, uint8_t value);
+
+    static constexpr size_t kROMBankSize = 0x4000;
+    static constexpr size_t kRAMBankSize = 0x2000;
+
+private:
+    std::shared_ptr<const RomImage> image; // whole banks, a power of two of them
+    const uint8_t* rom = nullptr;          // image->Data()
+    std::vector<uint8_t> ram;
+    std::unique_ptr<SaveFile> save;
+    std::unique_ptr<SaveFile> rtcSave;
+    std::bitset<0x20000 / SaveFile::kPageSize> dirtyPages; // up to 128 KB of RAM
+    bool rtcDirty = false;
+    MBC mbc = MBC::None;
+    bool battery = false;
+    bool rtc = false;
+    uint16_t romBankCount = 2;
+    uint8_t ramBankCount = 0;
+
+    // Bank registers as written by the game
+    bool ramEnabled = false;
+    uint16_t romBankReg = 1; // MBC1: 5 bits, MBC2: 4, MBC3: 7, MBC5: 9
+    uint8_t upperReg = 0;    // MBC1 upper bits / RAM bank; MBC3/5 RAM bank or RTC select
+    bool mode = false;       // MBC1 banking mode
+
+    // MBC3 clock, computed from emulated time when latched
+    RealTimeClock rtcClock;
+    const Scheduler* scheduler = nullptr;
+    uint8_t latchReg = 0xFF;
+    uint64_t Now() const;
+
+    // Resolved from the registers by UpdateBanks()
+    uint16_t bank0 = 0;
+    uint16_t bankX = 1;
+    uint8_t ramBank = 0;
+
+    uint8_t UpdateBanks();
+    void DetachSave();
+    size_t RAMOffset(uint16_t addr) const { return mbc == MBC::MBC2 ? (addr & 0x01FF) : ramBank * kRAMBankSize + (addr & 0x1FFF); }
+    bool RTCSelected() const { return mbc == MBC::MBC3 && upperReg >= 0x08 && upperReg <= 0x0C; }
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// The guest memory an instance owns, as one cache-line-aligned block owned
+// by the MMU and lent to the PPU (VRAM/OAM) and the IO table. Keeping it
+// together means a core's working set is a handful of contiguous pages
+// instead of arrays spread across its components. ROM is not in here (it
+// is a shared RomImage), nor is cartridge RAM (sized by the cartridge).
+struct alignas(64) CoreMemory
+{
+    uint8_t wram[0x2000]; // C000-DFFF, echoed at E000-FDFF
+    uint8_t vram[0x2000]; // 8000-9FFF
+    uint8_t oam[0xA0];    // FE00-FE9F
+    uint8_t io[0x80];     // FF00-FF7F, last value written
+    uint8_t hram[0x7F];   // FF80-FFFE
+};
@@ -0,0 +1,37 @@
+#include "DevCore.h"
+
+namespace
+{
+    std::unique_ptr<Emulator> NewCore(bool framebuffer)
+    {
+        auto emulator = std::make_unique<Emulator>();
+        emulator->GetMMU().SetSaveFilesEnabled(false);
+        emulator->GetPPU().SetFramebufferEnabled(framebuffer);
+        return emulator;
+    }
+
+    void SetMode(Emulator& emulator, ExecutionMode mode)
+    {
+        emulator.GetCPU().SetBlockCacheEnabled(mode != ExecutionMode::Interpreter);
+        emulator.GetCPU().SetJitEnabled(mode == ExecutionMode::Jit);
+    }
+}
+
+std::unique_ptr<Emulator> MakeScratchCore(std::vector<uint8_t> image, ExecutionMode mode, bool framebuffer)
+{
+    auto emulator = NewCore(framebuffer);
+    emulator->LoadRomImage(std::move(image));
+    SetMode(*emulator, mode);
+    return emulator;
+}
+
+std::unique_ptr<Emulator> MakeScratchCore(const std::string& romPath, ExecutionMode mode, bool framebuffer)
+{
+    auto emulator = NewCore(framebuffer);
+    if (romPath.empty())
+        emulator->LoadTestProgram();
+    else if (!emulator->LoadRom(romPath))
+        return nullptr;
+    SetMode(*emulator, mode);
+    return emulator;
+}
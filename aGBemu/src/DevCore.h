@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Emulator.h"
+
+// Scratch cores for the dev benchmarks and checks: a private Emulator that
+// never touches the player's .sav, so they can run while a game is loaded.
+enum class ExecutionMode { Interpreter, BlockCache, Jit };
+
+// A generated cartridge image, started from power-on in `mode`. The
+// framebuffer is off unless the caller is timing the PPU too.
+std::unique_ptr<Emulator> MakeScratchCore(std::vector<uint8_t> image, ExecutionMode mode, bool framebuffer = false);
+
+// The same on a ROM file (the built-in test program when the path is
+// empty); nullptr when the file cannot be loaded
+std::unique_ptr<Emulator> MakeScratchCore(const std::string& romPath, ExecutionMode mode, bool framebuffer = false);
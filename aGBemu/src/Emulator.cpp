@@ -1,10 +1,6 @@
 #include "Emulator.h"
-#include <cstring>
-#include <iostream>
-#include <fstream>
 
 Emulator::Emulator()
-	: mmu(&ppu), cpu(&mmu) // Initialize MMU with PPU, CPU with MMU
 {
 
 }
@@ -16,93 +12,51 @@ Emulator::~Emulator()
 
 bool Emulator::LoadRom(const std::string& romName)
 {
-	// Clear cartridge memory
-	memset(m_cartridgeMemory, 0, sizeof(m_cartridgeMemory));
-
-	// Open ROM file
-	std::ifstream file(romName, std::ios::binary);
-
-	// if the file does not read correctly, return false
-	if (!file) {
-		std::cerr << "Failed to open ROM: " << romName << std::endl;
+	// The MMU's cartridge parses the header and sets up banking
+	if (!mmu.LoadROMFromFile(romName.c_str()))
 		return false;
-	}
-
-	// Read ROM into memory
-	file.read(reinterpret_cast<char*>(m_cartridgeMemory), sizeof(m_cartridgeMemory));
-
-	// Detect Oversized ROM
-	if (file.gcount() == sizeof(m_cartridgeMemory)) {
-		std::cerr << "Warning: ROM may be too large for memory!" << std::endl;
-		// Possible Future Implementation.
-	}
-
-	// Return true if any bytes are read
-	return file.gcount() > 0;
-}
-
-void Emulator::Update()
-{
-	// Number of CPU cycles per frame, at 60 frames per second.
-	const int MAX_CYCLES = 69905;
-
-	// counter for number of cycles this frame.
-	int currentCycles = 0;
-
-	// Execute instructions up to the number of operations per frame. 
-	while (currentCycles < MAX_CYCLES)
-	{
-		int cycles = ExecuteNextOpcode();
-
-		// If max number of cycles will be broke, c
-		if (currentCycles + cycles > MAX_CYCLES)
-		{
-			cycles = MAX_CYCLES - currentCycles;
-		}
-
-		currentCycles += cycles;
-
-		UpdateTimers(cycles);
-		UpdateGraphics(cycles);
-		DoInterrupts();
-	}
-
-	RenderScreen();
+	romPath = romName;
+	Reset();
+	return true;
 }
 
-void Emulator::UpdateTimers(int cycles)
+void Emulator::LoadTestProgram()
 {
-	// Not Yet Implemented
+	mmu.LoadTestProgram();
+	romPath.clear();
+	Reset();
 }
 
-void Emulator::UpdateGraphics(int cycles)
+void Emulator::LoadRomImage(std::vector<uint8_t> image)
 {
-	// Not Yet Implemented
+	mmu.LoadROMFromBytes(std::move(image));
+	romPath.clear();
+	Reset();
 }
 
-void Emulator::DoInterrupts()
+void Emulator::Reset()
 {
-	// Not Yet Implemented
+	// The PPU comes before the MMU, which starts LY from its LCDC
+	cpu.Reset();
+	ppu.Reset();
+	mmu.Reset();
+	overshoot = 0;
 }
 
-int Emulator::ExecuteNextOpcode()
+void Emulator::RunFrame()
 {
-	// Step CPU once
-	cpu.Step();
-
-	// For now, return 1 cycle per instruction (simplified)
-	return 1;
+	// The PPU draws each line as it is reached and swaps finished frames in
+	// at VBlank, so the framebuffer holds the last complete frame
+	RunCycles(kCyclesPerFrame);
 }
 
-void Emulator::RenderScreen()
+uint64_t Emulator::RunCycles(uint32_t cycles)
 {
-	// Get PPU framebuffer for rendering
-	uint8_t* framebuffer = ppu.GetFramebuffer();
-
-	// TODO: integrate with SDL/OpenGL renderer
-	// Example for testing first pixel:
-	// std::cout << "Pixel 0 RGB: "
-	//           << int(framebuffer[0]) << ", "
-	//           << int(framebuffer[1]) << ", "
-	//           << int(framebuffer[2]) << std::endl;
+	// Timers, graphics and interrupts run off the scheduler while the CPU
+	// executes the whole burst; the previous burst's overshoot comes off
+	// this one.
+	const uint64_t start = mmu.GetScheduler().Now();
+	const uint64_t end = start + cycles - overshoot;
+	overshoot = cpu.RunUntil(end);
+	return mmu.GetScheduler().Now() - start;
 }
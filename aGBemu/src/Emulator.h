@@ -1,20 +1,56 @@
 #pragma once
 
 #include <string>
-#include <fstream>
-#include "Types.h"
+#include <vector>
 #include "CPU.h"
 #include "MMU.h"
 #include "PPU.h"
 
+// One Game Boy: owns the components and runs them. The frontend, the
+// benchmarks and headless users all drive the core through RunFrame or
+// RunCycles, so the scheduler, HALT skip, block cache and JIT only ever
+// have one loop to run in.
 class Emulator
 {
 public:
+    // Cycles per host frame: ~4.19 MHz / 60 Hz
+    static constexpr uint32_t kCyclesPerFrame = 69905;
+
     Emulator();
     ~Emulator();
+    Emulator(const Emulator&) = delete;
+    Emulator& operator=(const Emulator&) = delete;
 
+    // Load a cartridge and restart the machine with it
     bool LoadRom(const std::string& romName);
-    void Update();
+    // The built-in test program instead of a cartridge (dev only)
+    void LoadTestProgram();
+    // A cartridge image built in memory (generated test ROMs; dev only)
+    void LoadRomImage(std::vector<uint8_t> image);
+    bool IsRomLoaded() const { return mmu.IsROMLoaded(); }
+    const std::string& GetRomPath() const { return romPath; }
+    // Increments with every successful LoadRom
+    uint32_t GetRomLoadGeneration() const { return mmu.GetROMLoadGeneration(); }
+
+    // Power-on state, keeping the cartridge
+    void Reset();
+
+    // Run one host frame's worth of cycles
+    void RunFrame();
+
+    // Run `cycles` cycles as one burst. Whatever the last instruction runs
+    // past the end is taken off the next call, so consecutive calls keep
+    // exact time. Returns the cycles run by this call.
+    uint64_t RunCycles(uint32_t cycles);
+
+    // RGBA32 framebuffer of the last rendered frame; nullptr when disabled
+    uint32_t* GetFramebuffer() { return ppu.GetFramebuffer(); }
+    // Changes with every new picture in the framebuffer
+    uint32_t GetFrameSerial() const { return ppu.GetFrameSerial(); }
+
+    CPU& GetCPU() { return cpu; }
+    MMU& GetMMU() { return mmu; }
+    PPU& GetPPU() { return ppu; }
 
 private:
     // --- Core components ---
@@ -22,13 +58,8 @@ private:
     MMU mmu{ &ppu };
     CPU cpu{ &mmu };
 
-    // Cartridge memory (ROM)
-    BYTE m_cartridgeMemory[0x200000]; // 2 MB max
+    std::string romPath;
 
-    // Frame update helpers
-    void UpdateTimers(int cycles);
-    void UpdateGraphics(int cycles);
-    void DoInterrupts();
-    int ExecuteNextOpcode();
-    void RenderScreen();
+    // Cycles the previous burst ran past its end
+    int64_t overshoot = 0;
 };
@@ -0,0 +1,144 @@
+#include "ExecutionCheck.h"
+#include "DevCore.h"
+#include "Jit.h"
+#include "Opcodes.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    constexpr uint16_t kLoopStart = 0x0150;
+    constexpr uint32_t kMemoryCheckInterval = 64; // steps between WRAM/HRAM compares
+
+    // Anything that leaves the loop on its own stays out of the body
+    bool IsStraightLine(uint8_t opcode)
+    {
+        const std::string_view name = kOpcodeTable[opcode].mnemonic;
+        for (const char* flow : { "J", "CALL", "RET", "RST", "HALT", "STOP", "ILLEGAL" })
+            if (name.starts_with(flow))
+                return false;
+        return true;
+    }
+
+    // 64 KB MBC1 image of random bytes with a loop at kLoopStart: random
+    // straight-line instructions, a JR NZ back to the start and a JP back
+    std::vector<uint8_t> GenerateProgram(uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> image(0x10000);
+        for (uint8_t& byte : image)
+            byte = static_cast<uint8_t>(rng());
+        image[0x0147] = 0x01; // MBC1
+        image[0x0148] = 0x01; // 4 banks
+        image[0x0149] = 0x00; // no RAM
+
+        const uint8_t entry[] = { 0x00, 0xC3, kLoopStart & 0xFF, kLoopStart >> 8 }; // NOP; JP loop
+        std::copy(std::begin(entry), std::end(entry), image.begin() + 0x0100);
+
+        uint16_t pc = kLoopStart;
+        const uint32_t count = 8 + rng() % 32;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint8_t opcode;
+            do
+                opcode = static_cast<uint8_t>(rng());
+            while (!IsStraightLine(opcode));
+            image[pc] = opcode; // operand bytes stay random
+            pc += kOpcodeTable[opcode].length;
+        }
+        image[pc++] = 0x20; // JR NZ,loop
+        image[pc] = static_cast<uint8_t>(kLoopStart - (pc + 1));
+        pc++;
+        image[pc++] = 0xC3; // JP loop
+        image[pc++] = kLoopStart & 0xFF;
+        image[pc++] = kLoopStart >> 8;
+        return image;
+    }
+
+    // What differs, or empty
+    std::string CompareState(Emulator& reference, Emulator& tested, bool memory)
+    {
+        const CPU::Registers a = reference.GetCPU().GetRegisters();
+        const CPU::Registers b = tested.GetCPU().GetRegisters();
+        if (a.AF != b.AF || a.BC != b.BC || a.DE != b.DE || a.HL != b.HL || a.SP != b.SP || a.PC != b.PC)
+        {
+            char text[160];
+            std::snprintf(text, sizeof(text),
+                          "registers AF %04X/%04X BC %04X/%04X DE %04X/%04X HL %04X/%04X SP %04X/%04X PC %04X/%04X",
+                          a.AF, b.AF, a.BC, b.BC, a.DE, b.DE, a.HL, b.HL, a.SP, b.SP, a.PC, b.PC);
+            return text;
+        }
+        if (reference.GetCPU().IsHalted() != tested.GetCPU().IsHalted())
+            return "HALT state";
+
+        MMU& x = reference.GetMMU();
+        MMU& y = tested.GetMMU();
+        if (x.GetScheduler().Now() != y.GetScheduler().Now())
+            return "clock";
+        const Interrupts& ix = x.GetInterrupts();
+        const Interrupts& iy = y.GetInterrupts();
+        if (ix.ReadIF() != iy.ReadIF() || ix.ReadIE() != iy.ReadIE() ||
+            ix.IsMasterEnabled() != iy.IsMasterEnabled() || ix.IsEnableDelayed() != iy.IsEnableDelayed())
+            return "IF/IE/IME";
+
+        if (memory)
+        {
+            for (uint32_t addr = 0xC000; addr < 0xE000; addr++)
+                if (x.Peek8(static_cast<uint16_t>(addr)) != y.Peek8(static_cast<uint16_t>(addr)))
+                    return "WRAM";
+            for (uint32_t addr = 0xFF80; addr < 0xFFFF; addr++)
+                if (x.Peek8(static_cast<uint16_t>(addr)) != y.Peek8(static_cast<uint16_t>(addr)))
+                    return "HRAM";
+        }
+        return {};
+    }
+
+    // First mismatch over all programs, or empty
+    std::string CheckMode(ExecutionMode mode, uint32_t programs, uint64_t cycles)
+    {
+        for (uint32_t seed = 0; seed < programs; seed++)
+        {
+            const std::vector<uint8_t> image = GenerateProgram(seed);
+            auto reference = MakeScratchCore(image, ExecutionMode::Interpreter);
+            auto tested = MakeScratchCore(image, mode);
+            // Skipped idle iterations arrive as one step the reference cannot split
+            reference->GetCPU().SetIdleLoopSkipEnabled(false);
+            tested->GetCPU().SetIdleLoopSkipEnabled(false);
+
+            uint64_t referenceCycles = 0;
+            uint64_t testedCycles = 0;
+            for (uint32_t steps = 1; testedCycles < cycles; steps++)
+            {
+                testedCycles += tested->GetCPU().Step();
+                while (referenceCycles < testedCycles)
+                    referenceCycles += reference->GetCPU().Step();
+
+                std::string difference = referenceCycles != testedCycles
+                    ? "instruction boundaries"
+                    : CompareState(*reference, *tested, steps % kMemoryCheckInterval == 0 || testedCycles >= cycles);
+                if (!difference.empty())
+                {
+                    char where[96];
+                    std::snprintf(where, sizeof(where), "program %u, step %u, cycle %llu: ",
+                                  seed, steps, static_cast<unsigned long long>(testedCycles));
+                    return where + difference;
+                }
+            }
+        }
+        return {};
+    }
+}
+
+ExecutionCheckResult RunExecutionCheck(uint32_t programs, uint64_t cycles)
+{
+    ExecutionCheckResult result;
+    result.programs = programs;
+    result.blockCache = CheckMode(ExecutionMode::BlockCache, programs, cycles);
+    if (Jit::IsSupported())
+        result.jit = CheckMode(ExecutionMode::Jit, programs, cycles);
+    return result;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Dev-only lockstep comparison of the execution modes against the plain
+// interpreter. Each generated ROM (a hot loop of random straight-line code
+// in an MBC1 image that is random everywhere else, so stray jumps, stack
+// writes and interrupts land in random code too) runs on two private
+// cores: the mode under test steps once (an instruction, or a whole cached
+// block) and the interpreter catches up to the same clock. After every step
+// the registers, HALT, IF/IE/IME and the clock must agree, and WRAM/HRAM
+// every few steps and at the end.
+struct ExecutionCheckResult
+{
+    uint32_t programs = 0;
+    // First mismatch per mode; empty when every program matched (or, for
+    // the JIT, when the host cannot run it)
+    std::string blockCache;
+    std::string jit;
+};
+
+ExecutionCheckResult RunExecutionCheck(uint32_t programs = 16, uint64_t cycles = 1000000);
@@ -0,0 +1,32 @@
+#include "FrameBenchmark.h"
+#include "DevCore.h"
+#include "Jit.h"
+#include <chrono>
+#include <memory>
+
+namespace
+{
+    // Every mode starts from power-on so they all run the same frames
+    double FramesPerSecond(const std::string& romPath, uint32_t frames, ExecutionMode mode)
+    {
+        auto emulator = MakeScratchCore(romPath, mode, true); // drawing included, as in the frontend
+        if (!emulator)
+            return 0;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++)
+            emulator->RunFrame();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return frames / std::chrono::duration<double>(elapsed).count();
+    }
+}
+
+FrameBenchmarkResult RunFrameBenchmark(const std::string& romPath, uint32_t frames)
+{
+    FrameBenchmarkResult result;
+    result.interpreter = FramesPerSecond(romPath, frames, ExecutionMode::Interpreter);
+    result.blockCache = FramesPerSecond(romPath, frames, ExecutionMode::BlockCache);
+    if (Jit::IsSupported())
+        result.jit = FramesPerSecond(romPath, frames, ExecutionMode::Jit);
+    return result;
+}
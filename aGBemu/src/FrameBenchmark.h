@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Dev-only benchmark of Emulator::RunFrame with no frontend attached. Runs
+// a private Emulator on the given ROM (the built-in test program when the
+// path is empty) once per execution mode.
+struct FrameBenchmarkResult
+{
+    // Emulated frames per second; 0 when the mode is not available
+    double interpreter = 0;
+    double blockCache = 0;
+    double jit = 0;
+};
+
+FrameBenchmarkResult RunFrameBenchmark(const std::string& romPath, uint32_t frames = 600);
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+
+// The 128 IO registers at FF00-FF7F. Each device claims the registers it
+// implements when it is constructed, so an access is one table lookup and
+// at most one call however many devices there are. Registers nobody claims
+// read back the last value written, which is kept in the instance's
+// CoreMemory.
+class IORegisters
+{
+public:
+    explicit IORegisters(uint8_t* values) : values(values) {}
+
+    using ReadHandler = uint8_t (*)(void* context, uint16_t addr);
+    using WriteHandler = void (*)(void* context, uint16_t addr, uint8_t value);
+
+    // A null read handler reads back the last value written; a null write
+    // handler only stores it. unusedBits read as 1 either way.
+    void Register(uint16_t addr, void* context, ReadHandler read, WriteHandler write, uint8_t unusedBits = 0)
+    {
+        Entry& e = entries[addr & 0x7F];
+        e.read = read;
+        e.write = write;
+        e.context = context;
+        unused[addr & 0x7F] = unusedBits;
+    }
+
+    uint8_t Read(uint16_t addr) const
+    {
+        const Entry& e = entries[addr & 0x7F];
+        return static_cast<uint8_t>((e.read ? e.read(e.context, addr) : values[addr & 0x7F]) | unused[addr & 0x7F]);
+    }
+
+    void Write(uint16_t addr, uint8_t value)
+    {
+        const Entry& e = entries[addr & 0x7F];
+        values[addr & 0x7F] = value;
+        if (e.write)
+            e.write(e.context, addr, value);
+    }
+
+private:
+    struct Entry
+    {
+        ReadHandler read = nullptr;
+        WriteHandler write = nullptr;
+        void* context = nullptr;
+    };
+
+    Entry entries[0x80];
+    uint8_t* values;           // last values written, 0x80 bytes
+    uint8_t unused[0x80] = {}; // bits that read as 1
+};
@@ -0,0 +1,205 @@
+#include "IdleLoop.h"
+#include "CPU.h"
+#include "MMU.h"
+#include "Opcodes.h"
+#include "Scheduler.h"
+#include <algorithm>
+
+IdleLoopDetector::IdleLoopDetector(MMU* mmu, Scheduler* scheduler)
+    : mmu(mmu), scheduler(scheduler)
+{
+}
+
+void IdleLoopDetector::Reset()
+{
+    for (Loop& loop : loops)
+        loop = Loop{};
+    stats = Stats{};
+}
+
+// Values that move with the clock alone (DIV, TIMA); everything else the
+// loop can read only changes through an instruction or a scheduled event
+bool IdleLoopDetector::ChangesWithoutEvent(uint16_t addr)
+{
+    return addr == 0xFF04 || addr == 0xFF05;
+}
+
+uint32_t IdleLoopDetector::OnBackwardJump(const CPU& cpu, uint16_t head, uint16_t branchEnd, uint32_t jumpCycles)
+{
+    if (branchEnd > 0x8000 || branchEnd - head > kMaxLoopBytes)
+        return 0;
+    // Skipped iterations make no accesses for watchpoints or a trace to see
+    if (mmu->GetAccessPolicy() != AccessPolicy::Plain)
+        return 0;
+
+    const uint32_t bank = mmu->GetROMBank(head);
+    const uint32_t key = (bank << 16) | head;
+    Loop& loop = loops[head & 63];
+    if (loop.key != key || loop.end != branchEnd)
+    {
+        loop = Loop{};
+        loop.key = key;
+        loop.end = branchEnd;
+        loop.idle = Analyze(head, branchEnd, loop);
+        if (loop.idle)
+            stats.idleLoops++;
+    }
+    if (!loop.idle)
+        return 0;
+
+    if (loop.indirectReads)
+    {
+        const CPU::Registers r = cpu.GetRegisters();
+        if (((loop.indirectReads & READ_BC) && ChangesWithoutEvent(r.BC)) ||
+            ((loop.indirectReads & READ_DE) && ChangesWithoutEvent(r.DE)) ||
+            ((loop.indirectReads & READ_HL) && ChangesWithoutEvent(r.HL)) ||
+            ((loop.indirectReads & READ_FF00_C) && ChangesWithoutEvent(0xFF00 | r.C)))
+            return 0;
+    }
+
+    // Every instruction of a skipped iteration must complete before the
+    // next event is due, exactly as if it had been executed
+    const uint64_t afterJump = scheduler->Now() + jumpCycles;
+    const uint64_t limit = std::min(afterJump + kMaxSkip, scheduler->NextEventTime());
+    if (limit <= afterJump)
+        return 0;
+    const uint32_t skipped = static_cast<uint32_t>((limit - afterJump - 1) / loop.iterationCycles) * loop.iterationCycles;
+    if (skipped)
+    {
+        stats.skippedCycles += skipped;
+        stats.skips++;
+    }
+    return skipped;
+}
+
+// Straight-line body that reads memory but never writes it, and in which
+// every register or flag it tests is either loop-invariant or recomputed
+// earlier in the same iteration
+bool IdleLoopDetector::Analyze(uint16_t head, uint16_t end, Loop& loop)
+{
+    // Register bits follow the opcode encoding (B,C,D,E,H,L,-,A), then Z and C
+    constexpr uint16_t FZ = 1 << 8, FC = 1 << 9, HLREGS = (1 << 4) | (1 << 5);
+    auto reg = [](int r) { return static_cast<uint16_t>(1 << r); };
+
+    struct Access { uint16_t reads, writes; };
+    Access access[kMaxLoopBytes];
+    int count = 0;
+    uint32_t cycles = 0;
+
+    uint32_t addr = head;
+    while (addr < end)
+    {
+        const uint8_t op = mmu->Peek8(static_cast<uint16_t>(addr));
+        const OpcodeInfo& info = kOpcodeTable[op];
+        if (addr + info.length > end)
+            return false;
+        const uint16_t operand = info.length == 3 ? mmu->Peek16(static_cast<uint16_t>(addr + 1))
+                               : info.length == 2 ? mmu->Peek8(static_cast<uint16_t>(addr + 1)) : 0;
+        const int x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+        uint16_t r = 0, w = 0;
+
+        if (addr + info.length == end)
+        {
+            // The closing jump: JR/JP, or JR cc/JP cc testing Z or C
+            const bool conditional = (x == 0 && z == 0 && y >= 4) || (x == 3 && z == 2 && y < 4);
+            if (conditional)
+                r = (y & 3) < 2 ? FZ : FC;
+            else if (op != 0x18 && op != 0xC3)
+                return false;
+            cycles += conditional ? info.cyclesTaken : info.cycles;
+        }
+        else
+        {
+            if (op == 0x00)
+            {
+                // NOP
+            }
+            else if (x == 1 && op != 0x76)
+            {
+                // LD r, r / LD r, (HL)
+                if (y == 6) return false;
+                if (z == 6) { r = HLREGS; loop.indirectReads |= READ_HL; }
+                else r = reg(z);
+                w = reg(y);
+            }
+            else if (x == 0 && z == 6 && y != 6)
+            {
+                w = reg(y); // LD r, n
+            }
+            else if (x == 0 && (z == 4 || z == 5) && y != 6)
+            {
+                r = reg(y); // INC r / DEC r (C untouched)
+                w = reg(y) | FZ;
+            }
+            else if (x == 2 || (x == 3 && z == 6))
+            {
+                // ALU A, r / (HL) / n; ADC and SBC also read C, CP leaves A
+                r = reg(7);
+                if (x == 2 && z == 6) { r |= HLREGS; loop.indirectReads |= READ_HL; }
+                else if (x == 2) r |= reg(z);
+                if (y == 1 || y == 3) r |= FC;
+                w = FZ | FC | (y != 7 ? reg(7) : 0);
+            }
+            else if (op == 0x0A || op == 0x1A)
+            {
+                // LD A, (BC) / LD A, (DE)
+                r = op == 0x0A ? (reg(0) | reg(1)) : (reg(2) | reg(3));
+                loop.indirectReads |= op == 0x0A ? READ_BC : READ_DE;
+                w = reg(7);
+            }
+            else if (op == 0xFA || op == 0xF0)
+            {
+                // LD A, (nn) / LDH A, (n)
+                const uint16_t src = op == 0xFA ? operand : static_cast<uint16_t>(0xFF00 | operand);
+                if (ChangesWithoutEvent(src)) return false;
+                w = reg(7);
+            }
+            else if (op == 0xF2)
+            {
+                r = reg(1); // LD A, (FF00+C)
+                loop.indirectReads |= READ_FF00_C;
+                w = reg(7);
+            }
+            else if (op == 0x07 || op == 0x0F || op == 0x17 || op == 0x1F)
+            {
+                r = reg(7) | (op >= 0x17 ? FC : 0); // RLCA/RRCA/RLA/RRA
+                w = reg(7) | FZ | FC;
+            }
+            else if (op == 0x2F) { r = w = reg(7); } // CPL
+            else if (op == 0x37) { w = FC; }         // SCF
+            else if (op == 0x3F) { r = w = FC; }     // CCF
+            else if (op == 0xCB && (operand & 0xC0) == 0x40)
+            {
+                // BIT b, r / BIT b, (HL)
+                const int src = operand & 7;
+                if (src == 6) { r = HLREGS; loop.indirectReads |= READ_HL; }
+                else r = reg(src);
+                w = FZ;
+            }
+            else
+            {
+                return false;
+            }
+            cycles += InstructionCycles(op, static_cast<uint8_t>(operand));
+        }
+
+        access[count++] = { r, w };
+        addr += info.length;
+    }
+
+    // A value read before this iteration wrote it would carry state from the
+    // previous iteration
+    uint16_t writtenAnywhere = 0;
+    for (int i = 0; i < count; i++)
+        writtenAnywhere |= access[i].writes;
+    uint16_t defined = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (access[i].reads & writtenAnywhere & ~defined)
+            return false;
+        defined |= access[i].writes;
+    }
+
+    loop.iterationCycles = static_cast<uint16_t>(cycles);
+    return cycles > 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+
+class CPU;
+class MMU;
+class Scheduler;
+
+// Recognises polling loops such as
+//     wait: LDH A,(44) / CP 90 / JR NZ,wait
+// that only read memory and recompute every register they test, so each
+// iteration leaves the machine in exactly the state it started in. Until
+// the next scheduled event nothing they read can change, so whole
+// iterations up to that point are skipped by returning their cycles as
+// part of the closing jump.
+//
+// Loops are analysed once, from the opcode metadata, when their backward
+// jump is first taken; only ROM loops are considered so the verdict cannot
+// go stale through writes.
+class IdleLoopDetector
+{
+public:
+    struct Stats
+    {
+        uint64_t skippedCycles = 0;
+        uint64_t skips = 0;      // jumps that skipped at least one iteration
+        uint32_t idleLoops = 0;  // distinct loops found to be idle
+    };
+
+    IdleLoopDetector(MMU* mmu, Scheduler* scheduler);
+
+    // New ROM: forget analysed loops and statistics
+    void Reset();
+
+    // A jump ending at `branchEnd` went back to `head`; the clock is still at
+    // the start of the jump, which costs `jumpCycles`. Returns the extra
+    // cycles to report for the skipped iterations (0 if none).
+    uint32_t OnBackwardJump(const CPU& cpu, uint16_t head, uint16_t branchEnd, uint32_t jumpCycles);
+
+    const Stats& GetStats() const { return stats; }
+
+    static constexpr uint32_t kMaxSkip = 70224;  // one frame, so the caller gets control back
+    static constexpr uint16_t kMaxLoopBytes = 32;
+
+private:
+    // Address operands read through a register, checked on every skip
+    enum IndirectRead : uint8_t { READ_BC = 1, READ_DE = 2, READ_HL = 4, READ_FF00_C = 8 };
+
+    struct Loop
+    {
+        uint32_t key = UINT32_MAX; // (bank << 16) | head
+        uint16_t end = 0;          // one past the closing jump
+        uint16_t iterationCycles = 0;
+        uint8_t indirectReads = 0;
+        bool idle = false;
+    };
+
+    MMU* mmu;
+    Scheduler* scheduler;
+    Loop loops[64]; // direct-mapped on the head address
+    Stats stats;
+
+    bool Analyze(uint16_t head, uint16_t end, Loop& loop);
+    static bool ChangesWithoutEvent(uint16_t addr);
+};
@@ -0,0 +1,148 @@
+#include "InterruptCheck.h"
+#include "DevCore.h"
+#include "Jit.h"
+#include <initializer_list>
+#include <memory>
+
+namespace
+{
+    constexpr uint16_t kTimerVector = 0x0050;
+    constexpr int kStepLimit = 100000;
+
+    // IE = timer, TIMA = 0 counting every 16 cycles (overflow ~4K cycles
+    // away, so HALT has something to fast-forward over)
+    constexpr std::initializer_list<uint8_t> kStartTimer = {
+        0x3E, 0x04, 0xE0, 0xFF, // LD A,04; LDH (FF),A
+        0xAF, 0xE0, 0x05,       // XOR A; LDH (05),A
+        0x3E, 0x05, 0xE0, 0x07  // LD A,05; LDH (07),A
+    };
+    // IE = IF = timer: an interrupt is pending at once
+    constexpr std::initializer_list<uint8_t> kRequestNow = {
+        0x3E, 0x04, 0xE0, 0xFF, // LD A,04; LDH (FF),A
+        0xE0, 0x0F              // LDH (0F),A
+    };
+
+    // Program at 0x0100, JR -2 at the timer vector
+    std::vector<uint8_t> BuildImage(std::initializer_list<std::initializer_list<uint8_t>> code)
+    {
+        std::vector<uint8_t> image(0x8000, 0);
+        image[kTimerVector] = 0x18;
+        image[kTimerVector + 1] = 0xFE;
+        size_t pc = 0x0100;
+        for (const auto& part : code)
+            for (uint8_t byte : part)
+                image[pc++] = byte;
+        return image;
+    }
+
+    uint64_t Now(Emulator& emulator) { return emulator.GetMMU().GetScheduler().Now(); }
+
+    // Step until PC reaches `target`; the clock before and after that step,
+    // or false when it never does
+    bool StepTo(Emulator& emulator, uint16_t target, uint64_t& before, uint64_t& after)
+    {
+        for (int i = 0; i < kStepLimit; i++)
+        {
+            before = Now(emulator);
+            emulator.GetCPU().Step();
+            after = Now(emulator);
+            if (emulator.GetCPU().GetRegisters().PC == target)
+                return true;
+        }
+        return false;
+    }
+
+    // Dispatch left PC at the vector with `ret` pushed, IME and the timer
+    // IF bit clear, and took 20 cycles
+    bool Dispatched(Emulator& emulator, uint16_t ret, uint64_t before, uint64_t after)
+    {
+        const CPU::Registers r = emulator.GetCPU().GetRegisters();
+        const Interrupts& interrupts = emulator.GetMMU().GetInterrupts();
+        return after - before == 20 && r.SP == 0xFFFC && emulator.GetMMU().Peek16(0xFFFC) == ret &&
+               !interrupts.IsMasterEnabled() && !(interrupts.GetRequested() & Interrupts::INT_TIMER);
+    }
+
+    // When a NOP loop first sees the timer interrupt requested
+    uint64_t TimerRequestTime(ExecutionMode mode)
+    {
+        auto emulator = MakeScratchCore(BuildImage({ kStartTimer }), mode); // NOPs follow
+        for (int i = 0; i < kStepLimit; i++)
+        {
+            emulator->GetCPU().Step();
+            if (emulator->GetMMU().GetInterrupts().GetRequested() & Interrupts::INT_TIMER)
+                return Now(*emulator);
+        }
+        return 0;
+    }
+
+    void CheckMode(ExecutionMode mode, const char* name, std::vector<std::string>& failures)
+    {
+        auto fail = [&](const char* check) { failures.push_back(std::string(name) + ": " + check); };
+        uint64_t before = 0, after = 0;
+
+        // EI; INC B; INC B: one INC B runs, then the dispatch returns to the second
+        {
+            auto emulator = MakeScratchCore(BuildImage({ kRequestNow, { 0xFB, 0x04, 0x04, 0x18, 0xFE } }), mode);
+            const uint16_t secondInc = 0x0100 + static_cast<uint16_t>(kRequestNow.size()) + 2;
+            if (!StepTo(*emulator, kTimerVector, before, after) || emulator->GetCPU().GetRegisters().B != 1)
+                fail("EI delay");
+            else if (!Dispatched(*emulator, secondInc, before, after))
+                fail("dispatch");
+        }
+
+        // EI; DI; INC B; INC B; JR -2: never taken
+        {
+            auto emulator = MakeScratchCore(BuildImage({ kRequestNow, { 0xFB, 0xF3, 0x04, 0x04, 0x18, 0xFE } }), mode);
+            for (int i = 0; i < 1000; i++)
+                emulator->GetCPU().Step();
+            if (emulator->GetCPU().GetRegisters().B != 2 || emulator->GetCPU().GetRegisters().PC == kTimerVector)
+                fail("EI, DI");
+        }
+
+        const uint64_t requested = TimerRequestTime(mode);
+        if (requested == 0)
+        {
+            fail("timer never fired");
+            return;
+        }
+
+        // HALT; INC B; JR -2 with IME off: wakes at the request, no dispatch
+        {
+            auto emulator = MakeScratchCore(BuildImage({ kStartTimer, { 0x76, 0x04, 0x18, 0xFE } }), mode);
+            CPU& cpu = emulator->GetCPU();
+            uint64_t wake = 0;
+            for (int i = 0; i < kStepLimit && wake == 0; i++)
+            {
+                const bool halted = cpu.IsHalted();
+                before = Now(*emulator);
+                cpu.Step();
+                if (halted && !cpu.IsHalted())
+                    wake = before;
+            }
+            for (int i = 0; i < 100; i++)
+                cpu.Step();
+            if (wake != requested || cpu.GetRegisters().B != 1 || cpu.GetRegisters().SP != 0xFFFE ||
+                !(emulator->GetMMU().GetInterrupts().GetRequested() & Interrupts::INT_TIMER))
+                fail("HALT wake");
+        }
+
+        // EI; HALT; INC B with IME on: the vector 20 cycles after the request
+        {
+            auto emulator = MakeScratchCore(BuildImage({ kStartTimer, { 0xFB, 0x76, 0x04, 0x18, 0xFE } }), mode);
+            const uint16_t afterHalt = 0x0100 + static_cast<uint16_t>(kStartTimer.size()) + 2;
+            if (!StepTo(*emulator, kTimerVector, before, after) || after != requested + 20 ||
+                emulator->GetCPU().GetRegisters().B != 0 || !Dispatched(*emulator, afterHalt, before, after))
+                fail("HALT dispatch");
+        }
+    }
+}
+
+std::vector<std::string> RunInterruptCheck()
+{
+    std::vector<std::string> failures;
+    CheckMode(ExecutionMode::Interpreter, "interpreter", failures);
+    CheckMode(ExecutionMode::BlockCache, "block cache", failures);
+    if (Jit::IsSupported())
+        CheckMode(ExecutionMode::Jit, "JIT", failures);
+    return failures;
+}
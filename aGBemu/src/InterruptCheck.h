@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Dev-only checks of interrupt timing, run headless on small generated
+// programs in every execution mode the host supports:
+//   EI delay      the instruction after EI runs before a pending interrupt
+//   EI, DI        an interrupt pending across EI; DI is never taken
+//   dispatch      20 cycles, return address pushed, IF bit and IME cleared
+//   HALT wake     with IME off, HALT ends on the cycle the timer requests
+//                 its interrupt (the M-cycle a NOP loop would see it) and
+//                 execution continues after it without a dispatch
+//   HALT dispatch with IME on, the vector is reached 20 cycles after that
+// Returns "<mode>: <check>" for each failure; empty when all passed.
+std::vector<std::string> RunInterruptCheck();
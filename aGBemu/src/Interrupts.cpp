@@ -0,0 +1,32 @@
+#include "Interrupts.h"
+#include "IORegisters.h"
+
+Interrupts::Interrupts(IORegisters& io)
+{
+    io.Register(0xFF0F, this,
+        [](void* self, uint16_t) { return static_cast<Interrupts*>(self)->ReadIF(); },
+        [](void* self, uint16_t, uint8_t value) { static_cast<Interrupts*>(self)->WriteIF(value); },
+        0xE0);
+}
+
+void Interrupts::Reset()
+{
+    flags = 0;
+    enable = 0;
+    ime = false;
+    enableDelayed = false;
+    halted = stopped = false;
+    Update();
+}
+
+uint16_t Interrupts::Acknowledge()
+{
+    const uint8_t pending = GetPending();
+    int bit = 0;
+    while (!(pending & (1 << bit)))
+        bit++;
+    flags &= ~(1 << bit);
+    ime = false;
+    Update();
+    return static_cast<uint16_t>(0x40 + bit * 8);
+}
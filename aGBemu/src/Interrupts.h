@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+
+class IORegisters;
+
+// Interrupt controller: IF (FF0F) and IE (FFFF) plus the CPU side of
+// interrupt handling, i.e. IME, the one-instruction delay after EI, and the
+// HALT/STOP state that a request ends.
+//
+// Everything the CPU must act on before its next instruction is folded into
+// one cached flag that is recomputed only when one of its inputs changes, so
+// the per-instruction cost is a single test of NeedsService().
+class Interrupts
+{
+public:
+    // Sources as bits of IF and IE, in priority order
+    enum Source : uint8_t {
+        INT_VBLANK = 0x01,
+        INT_STAT   = 0x02,
+        INT_TIMER  = 0x04,
+        INT_SERIAL = 0x08,
+        INT_JOYPAD = 0x10
+    };
+
+    // Claims IF; IE (FFFF) is outside the IO range and stays with the MMU
+    explicit Interrupts(IORegisters& io);
+
+    void Reset();
+
+    // Devices raise their IF bit
+    void Request(uint8_t mask) { flags |= mask; Update(); }
+
+    // Register access; the unused IF bits are set by the IO table
+    uint8_t ReadIF() const { return flags; }
+    void WriteIF(uint8_t value) { flags = value & 0x1F; Update(); }
+    uint8_t ReadIE() const { return enable; }
+    void WriteIE(uint8_t value) { enable = value; Update(); }
+
+    uint8_t GetRequested() const { return flags; }
+    uint8_t GetPending() const { return flags & enable & 0x1F; }
+
+    // IME: EI sets it after the following instruction, RETI at once
+    bool IsMasterEnabled() const { return ime; }
+    bool IsEnableDelayed() const { return enableDelayed; }
+    void EnableAfterNext() { enableDelayed = !ime; Update(); }
+    void Enable() { ime = true; enableDelayed = false; Update(); }
+    void Disable() { ime = false; enableDelayed = false; Update(); }
+
+    // HALT waits for any pending interrupt, STOP only for the joypad
+    bool IsHalted() const { return halted; }
+    bool IsStopped() const { return stopped; }
+    void Halt(bool stop) { halted = true; stopped = stop; Update(); }
+    void Wake() { halted = stopped = false; Update(); }
+
+    // Cached IME && (IE & IF), or a HALT/EI state to resolve
+    bool NeedsService() const { return service; }
+    const bool* GetServiceAddress() const { return &service; }
+
+    // Take the highest-priority pending interrupt: clears IME and its IF bit
+    // and returns the vector (0x40, 0x48, ... 0x60)
+    uint16_t Acknowledge();
+
+private:
+    uint8_t flags = 0;  // IF
+    uint8_t enable = 0; // IE
+    bool ime = false;
+    bool enableDelayed = false;
+    bool halted = false;
+    bool stopped = false;
+    bool service = false;
+
+    void Update() { service = halted || enableDelayed || (ime && GetPending() != 0); }
+};
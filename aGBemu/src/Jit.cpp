@@ -0,0 +1,525 @@
+#include "Jit.h"
+#include "BlockCache.h"
+#include "Scheduler.h"
+#include "Interrupts.h"
+#include "CPU.h"
+#include "Opcodes.h"
+#include <array>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define GBEMU_JIT_X64 1
+#endif
+
+#ifdef GBEMU_JIT_X64
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+bool Jit::IsSupported()
+{
+#ifdef GBEMU_JIT_X64
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef GBEMU_JIT_X64
+
+// LAHF layout (SF ZF - AF - PF - CF) -> SM83 F layout (Z N H C 0000)
+static constexpr std::array<uint8_t, 256> MakeLahfToFlags()
+{
+    std::array<uint8_t, 256> lut{};
+    for (int ah = 0; ah < 256; ah++)
+    {
+        lut[ah] = static_cast<uint8_t>(((ah & 0x40) ? 0x80 : 0) |
+                                       ((ah & 0x10) ? 0x20 : 0) |
+                                       ((ah & 0x01) ? 0x10 : 0));
+    }
+    return lut;
+}
+
+static constexpr std::array<uint8_t, 256> kLahfToFlags = MakeLahfToFlags();
+
+// Host registers (low 3 bits of the x86 encoding)
+enum HostReg8 { AL = 0, CL = 1, DL = 2, AH = 4 };
+
+// Minimal x86-64 encoder for the handful of forms the translator needs.
+// CPU state is addressed as [rbx + disp32].
+class X64Emitter
+{
+public:
+    X64Emitter(uint8_t* start, uint8_t* limit) : p(start), limit(limit) {}
+
+    bool Overflowed() const { return overflow; }
+    uint8_t* Position() const { return p; }
+
+    void Byte(uint8_t b) { if (p < limit) *p++ = b; else overflow = true; }
+    void Bytes(std::initializer_list<uint8_t> bytes) { for (uint8_t b : bytes) Byte(b); }
+    void Imm16(uint16_t v) { Byte(v & 0xFF); Byte(v >> 8); }
+    void Imm32(uint32_t v) { for (int i = 0; i < 4; i++) Byte((v >> (i * 8)) & 0xFF); }
+    void Imm64(uint64_t v) { for (int i = 0; i < 8; i++) Byte((v >> (i * 8)) & 0xFF); }
+
+    // mod=10 rm=rbx: [rbx + disp32]
+    void Mem(int reg, int32_t disp) { Byte(0x80 | (reg << 3) | 3); Imm32(static_cast<uint32_t>(disp)); }
+
+    void LoadR8(HostReg8 r, int32_t off)  { Byte(0x8A); Mem(r, off); }     // mov r8, [rbx+off]
+    void StoreR8(int32_t off, HostReg8 r) { Byte(0x88); Mem(r, off); }     // mov [rbx+off], r8
+    void StoreImm8(int32_t off, uint8_t v) { Byte(0xC6); Mem(0, off); Byte(v); }
+    void StoreImm16(int32_t off, uint16_t v) { Bytes({ 0x66, 0xC7 }); Mem(0, off); Imm16(v); }
+    void MovzxR32M8(int r, int32_t off) { Bytes({ 0x0F, 0xB6 }); Mem(r, off); }
+    void MovzxR32M16(int r, int32_t off) { Bytes({ 0x0F, 0xB7 }); Mem(r, off); }
+    void StoreR16(int32_t off, int r) { Bytes({ 0x66, 0x89 }); Mem(r, off); }    // mov [rbx+off], r16
+    void Group1M8(int ext, int32_t off, uint8_t v) { Byte(0x80); Mem(ext, off); Byte(v); } // and/or/xor/cmp byte [rbx+off], imm8
+
+    void Prologue()
+    {
+        Bytes({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56 }); // push rbx, r12, r13, r14
+#ifdef _WIN32
+        Bytes({ 0x48, 0x83, 0xEC, 40 });                     // sub rsp, 40 (shadow space + align)
+        Bytes({ 0x48, 0x89, 0xCB });                         // mov rbx, rcx
+#else
+        Bytes({ 0x48, 0x83, 0xEC, 8 });                      // sub rsp, 8 (align)
+        Bytes({ 0x48, 0x89, 0xFB });                         // mov rbx, rdi
+#endif
+    }
+
+    void Epilogue()
+    {
+#ifdef _WIN32
+        Bytes({ 0x48, 0x83, 0xC4, 40 });
+#else
+        Bytes({ 0x48, 0x83, 0xC4, 8 });
+#endif
+        Bytes({ 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3 }); // pop r14, r13, r12, rbx; ret
+    }
+
+    // handler(cpu, operand); result in eax
+    void CallHandler(const void* fn, uint16_t operand)
+    {
+#ifdef _WIN32
+        Bytes({ 0x48, 0x89, 0xD9 }); // mov rcx, rbx
+        Byte(0xBA); Imm32(operand);  // mov edx, imm32
+#else
+        Bytes({ 0x48, 0x89, 0xDF }); // mov rdi, rbx
+        Byte(0xBE); Imm32(operand);  // mov esi, imm32
+#endif
+        Bytes({ 0x48, 0xB8 }); Imm64(reinterpret_cast<uint64_t>(fn)); // mov rax, imm64
+        Bytes({ 0xFF, 0xD0 });                                        // call rax
+    }
+
+private:
+    uint8_t* p;
+    uint8_t* limit;
+    bool overflow = false;
+};
+
+// The code cache is never writable and executable at once (W^X): it is
+// mapped read-write, and Compile flips it to read-execute before any of
+// the code it emitted runs
+static void* AllocateExecutable(size_t size)
+{
+#ifdef _WIN32
+    return VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return mem == MAP_FAILED ? nullptr : mem;
+#endif
+}
+
+static bool SetWritable(void* mem, size_t size, bool writable)
+{
+#ifdef _WIN32
+    DWORD previous;
+    if (!VirtualProtect(mem, size, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &previous))
+        return false;
+    return writable || FlushInstructionCache(GetCurrentProcess(), mem, size);
+#else
+    return mprotect(mem, size, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+static void FreeExecutable(void* mem, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(mem, 0, MEM_RELEASE);
+#else
+    munmap(mem, size);
+#endif
+}
+
+Jit::Jit(CPU* cpu, BlockCache* blockCache, const DecodedHandler* handlers)
+    : cpu(cpu), blockCache(blockCache), handlers(handlers)
+{
+    code = static_cast<uint8_t*>(AllocateExecutable(kCodeCacheSize));
+    blockCache->SetJit(this);
+
+    auto offset = [cpu](const void* field) {
+        return static_cast<int32_t>(static_cast<const uint8_t*>(field) - reinterpret_cast<const uint8_t*>(cpu));
+    };
+    offReg[0] = offset(&cpu->B);
+    offReg[1] = offset(&cpu->C);
+    offReg[2] = offset(&cpu->D);
+    offReg[3] = offset(&cpu->E);
+    offReg[4] = offset(&cpu->H);
+    offReg[5] = offset(&cpu->L);
+    offReg[7] = offset(&cpu->A);
+    offF = offset(&cpu->F);
+    offSP = offset(&cpu->SP);
+    offPair[0] = offset(&cpu->BC);
+    offPair[1] = offset(&cpu->DE);
+    offPair[2] = offset(&cpu->HL);
+    offPair[3] = offSP;
+    offPC = offset(&cpu->PC);
+    offFlagOp = offset(&cpu->flagOp);
+}
+
+Jit::~Jit()
+{
+    blockCache->SetJit(nullptr);
+    if (code)
+        FreeExecutable(code, kCodeCacheSize);
+}
+
+void Jit::Flush()
+{
+    blockCache->DropNativeCode();
+    used = 0;
+    compiledBlocks = 0;
+}
+
+int Jit::SyncFlags(CPU& cpu, uint16_t)
+{
+    cpu.MaterializeFlags();
+    return 0;
+}
+
+int Jit::RunEvents(CPU& cpu, uint16_t)
+{
+    cpu.scheduler->Advance(0);
+    return 0;
+}
+
+bool Jit::Compile(Block& block)
+{
+    // Only ROM code: it cannot be overwritten, so a translation is valid for
+    // as long as its (bank, PC) key is
+    if (!code || block.startPC >= 0x8000)
+        return false;
+
+    if (!SetWritable(code, kCodeCacheSize, true))
+        return false;
+
+    uint8_t* out = code + used;
+    bool translated = Translate(block, out, code + kCodeCacheSize);
+    if (!translated)
+    {
+        Flush();
+        out = code;
+        translated = Translate(block, out, code + kCodeCacheSize);
+    }
+
+    // Everything already compiled runs from this mapping too, so if it
+    // cannot be made executable again none of it may be entered
+    if (!SetWritable(code, kCodeCacheSize, false))
+    {
+        Flush();
+        return false;
+    }
+    if (!translated)
+        return false;
+
+    block.native = reinterpret_cast<Block::NativeCode>(code + used);
+    used = out - code;
+    compiledBlocks++;
+    return true;
+}
+
+// Which opcodes have an inline translation
+static bool IsNative(uint8_t op)
+{
+    const int x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+    if (x == 1) return y != 6 && z != 6;                  // LD r, r
+    if (x == 2) return z != 6;                            // ALU A, r
+    if (x == 3 && z == 6) return true;                    // ALU A, n
+    if (x == 0 && (z == 4 || z == 5 || z == 6)) return y != 6; // INC r / DEC r / LD r, n
+    if (x == 0 && (z == 1 || z == 3)) return true;        // LD rr, nn / ADD HL, rr / INC rr / DEC rr
+    return op == 0x00 || op == 0x2F || op == 0x37 || op == 0x3F; // NOP, CPL, SCF, CCF
+}
+
+bool Jit::Translate(Block& block, uint8_t*& out, uint8_t* limit)
+{
+    X64Emitter e(out, limit);
+    const int32_t offA = offReg[7];
+
+    e.Prologue();
+    e.Bytes({ 0x49, 0xBC }); e.Imm64(reinterpret_cast<uint64_t>(kLahfToFlags.data()));   // mov r12, lut
+    e.Bytes({ 0x49, 0xBE }); e.Imm64(reinterpret_cast<uint64_t>(blockCache->GetEpochAddress())); // mov r14, &epoch
+    e.Bytes({ 0x45, 0x8B, 0x2E });                                                         // mov r13d, [r14]
+
+    // Host flags -> F via the LAHF table; ecx = SM83 flags with N cleared
+    auto flagsFromHost = [&]() {
+        e.Byte(0x9F);                                   // lahf
+        e.Bytes({ 0x0F, 0xB6, 0xCC });                  // movzx ecx, ah
+        e.Bytes({ 0x41, 0x0F, 0xB6, 0x0C, 0x0C });      // movzx ecx, byte [r12 + rcx]
+    };
+    // Load the carry flag into host CF for ADC/SBC
+    auto carryToHost = [&]() {
+        e.MovzxR32M8(DL, offF);
+        e.Bytes({ 0x0F, 0xBA, 0xE2, 0x04 });            // bt edx, 4
+    };
+
+    // Scheduler clock += imm32 (or rax), then run events if one fell due
+    Scheduler* scheduler = cpu->scheduler;
+    const Interrupts* interrupts = cpu->interrupts;
+    auto advanceClock = [&](uint32_t amount, bool byRax) {
+        if (!byRax && amount == 0)
+            return;
+        e.Bytes({ 0x48, 0xB9 }); e.Imm64(reinterpret_cast<uint64_t>(scheduler->GetNowAddress()));       // mov rcx, &now
+        if (byRax)
+        {
+            // Handlers return int: only eax is defined, the upper half of rax is not
+            e.Bytes({ 0x89, 0xC0 });                                                                   // mov eax, eax
+            e.Bytes({ 0x48, 0x01, 0x01 });                                                             // add [rcx], rax
+        }
+        else
+            { e.Bytes({ 0x48, 0x81, 0x01 }); e.Imm32(amount); }                                        // add qword [rcx], imm32
+        e.Bytes({ 0x48, 0x8B, 0x09 });                                                                 // mov rcx, [rcx]
+        e.Bytes({ 0x48, 0xBA }); e.Imm64(reinterpret_cast<uint64_t>(scheduler->GetNextEventAddress())); // mov rdx, &nextEvent
+        e.Bytes({ 0x48, 0x3B, 0x0A });                                                                 // cmp rcx, [rdx]
+        uint8_t* notDue = e.Position();
+        e.Bytes({ 0x72, 0x00 });                                                                       // jb past the call
+        e.CallHandler(reinterpret_cast<const void*>(&Jit::RunEvents), 0);
+        if (!e.Overflowed())
+            notDue[1] = static_cast<uint8_t>(e.Position() - notDue - 2);
+    };
+
+    uint16_t pc = block.startPC;
+    uint32_t cycles = 0;
+    uint32_t advanced = 0; // cycles already added to the scheduler clock
+    for (size_t i = 0; i < block.ops.size(); i++)
+    {
+        const MicroOp& op = block.ops[i];
+        const uint8_t opcode = op.opcode;
+        const int x = opcode >> 6, y = (opcode >> 3) & 7, z = opcode & 7;
+        const bool last = (i + 1 == block.ops.size());
+        pc = static_cast<uint16_t>(pc + op.length);
+
+        if (!IsNative(opcode))
+        {
+            // Interpreter fallback with PC already past the instruction, as Step() leaves it
+            advanceClock(cycles - advanced, false);
+            advanced = cycles;
+            e.StoreImm16(offPC, pc);
+            e.CallHandler(reinterpret_cast<const void*>(handlers[opcode]), op.operand);
+
+            if (last)
+            {
+                // Block-ending branches report taken/not-taken cost themselves
+                e.Bytes({ 0x41, 0x89, 0xC5 });              // mov r13d, eax
+                advanceClock(0, true);
+                e.Bytes({ 0x44, 0x89, 0xE8 });              // mov eax, r13d
+                e.Byte(0x05); e.Imm32(cycles);              // add eax, cycles
+                e.Epilogue();
+                out = e.Position();
+                return !e.Overflowed();
+            }
+
+            cycles += InstructionCycles(opcode, static_cast<uint8_t>(op.operand));
+
+            // A write that invalidated cached code or switched banks ends the block here.
+            // So does anything Service() must see (IE/IF write, EI/DI), or an event
+            // the handler scheduled before the end of the block.
+            e.Bytes({ 0x45, 0x3B, 0x2E });                  // cmp r13d, [r14]
+            uint8_t* stale = e.Position();
+            e.Bytes({ 0x75, 0x00 });                        // jne to the exit below
+            e.Bytes({ 0x48, 0xB9 }); e.Imm64(reinterpret_cast<uint64_t>(interrupts->GetServiceAddress())); // mov rcx, &service
+            e.Bytes({ 0x80, 0x39, 0x00 });                  // cmp byte [rcx], 0
+            uint8_t* service = e.Position();
+            e.Bytes({ 0x75, 0x00 });                        // jne to the exit below
+            e.Bytes({ 0x48, 0xB9 }); e.Imm64(reinterpret_cast<uint64_t>(scheduler->GetNowAddress()));       // mov rcx, &now
+            e.Bytes({ 0x48, 0x8B, 0x09 });                  // mov rcx, [rcx]
+            e.Bytes({ 0x48, 0x81, 0xC1 }); e.Imm32(block.maxCycles - advanced); // add rcx, cycles left
+            e.Bytes({ 0x48, 0xBA }); e.Imm64(reinterpret_cast<uint64_t>(scheduler->GetNextEventAddress())); // mov rdx, &nextEvent
+            e.Bytes({ 0x48, 0x3B, 0x0A });                  // cmp rcx, [rdx]
+            uint8_t* inTime = e.Position();
+            e.Bytes({ 0x72, 0x00 });                        // jb past the exit
+            if (!e.Overflowed())
+            {
+                stale[1] = static_cast<uint8_t>(e.Position() - stale - 2);
+                service[1] = static_cast<uint8_t>(e.Position() - service - 2);
+            }
+            advanceClock(cycles - advanced, false);
+            e.Byte(0xB8); e.Imm32(cycles);                  // mov eax, cycles
+            e.Epilogue();
+            if (!e.Overflowed())
+                inTime[1] = static_cast<uint8_t>(e.Position() - inTime - 2);
+
+            // The handler may have recorded lazy flags; inline code expects F
+            if (IsNative(block.ops[i + 1].opcode))
+            {
+                e.Group1M8(7, offFlagOp, 0);                // cmp byte [flagOp], None
+                uint8_t* synced = e.Position();
+                e.Bytes({ 0x74, 0x00 });                    // je past the call
+                e.CallHandler(reinterpret_cast<const void*>(&Jit::SyncFlags), 0);
+                if (!e.Overflowed())
+                    synced[1] = static_cast<uint8_t>(e.Position() - synced - 2);
+            }
+            continue;
+        }
+
+        cycles += kOpcodeTable[opcode].cycles;
+
+        if (x == 1)
+        {
+            // LD r, r
+            e.LoadR8(AL, offReg[z]);
+            e.StoreR8(offReg[y], AL);
+        }
+        else if (x == 2 || (x == 3 && z == 6))
+        {
+            // ALU A, r / ALU A, n
+            if (x == 3)
+            {
+                e.Byte(0xB1); e.Byte(static_cast<uint8_t>(op.operand)); // mov cl, imm8
+            }
+            else
+            {
+                e.LoadR8(CL, offReg[z]);
+            }
+            e.LoadR8(AL, offA);
+            if (y == 1 || y == 3)
+                carryToHost();
+
+            static const uint8_t aluOps[8] = { 0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38 };
+            e.Bytes({ aluOps[y], 0xC8 });                   // op al, cl
+
+            if (y == 4 || y == 5 || y == 6)
+            {
+                // AND/XOR/OR: Z from the result, H set for AND, N and C clear
+                e.Bytes({ 0x0F, 0x94, 0xC1 });              // setz cl
+                e.Bytes({ 0xC0, 0xE1, 0x07 });              // shl cl, 7
+                if (y == 4)
+                    e.Bytes({ 0x80, 0xC9, 0x20 });          // or cl, 0x20
+            }
+            else
+            {
+                flagsFromHost();
+                if (y >= 2)
+                    e.Bytes({ 0x80, 0xC9, 0x40 });          // or cl, N
+            }
+            if (y != 7)
+                e.StoreR8(offA, AL);
+            e.StoreR8(offF, CL);
+        }
+        else if (x == 0 && (z == 4 || z == 5))
+        {
+            // INC r / DEC r: Z, N, H from the result, C preserved
+            e.LoadR8(AL, offReg[y]);
+            e.Bytes({ 0xFE, static_cast<uint8_t>(z == 4 ? 0xC0 : 0xC8) }); // inc al / dec al
+            flagsFromHost();
+            e.Bytes({ 0x80, 0xE1, 0xA0 });                  // and cl, Z|H
+            if (z == 5)
+                e.Bytes({ 0x80, 0xC9, 0x40 });              // or cl, N
+            e.LoadR8(DL, offF);
+            e.Bytes({ 0x80, 0xE2, 0x10 });                  // and dl, C
+            e.Bytes({ 0x08, 0xD1 });                        // or cl, dl
+            e.StoreR8(offReg[y], AL);
+            e.StoreR8(offF, CL);
+        }
+        else if (x == 0 && z == 6)
+        {
+            // LD r, n
+            e.StoreImm8(offReg[y], static_cast<uint8_t>(op.operand));
+        }
+        else if (x == 0 && z == 1 && (y & 1) == 0)
+        {
+            // LD rr, nn
+            e.StoreImm16(offPair[y >> 1], op.operand);
+        }
+        else if (x == 0 && z == 1)
+        {
+            // ADD HL, rr: N clear, H from bit 11, C from bit 15, Z preserved
+            e.MovzxR32M16(CL, offPair[y >> 1]);                         // ecx = rr
+            e.MovzxR32M16(AL, offPair[2]);                              // eax = HL
+            e.Bytes({ 0x89, 0xC2 });                                    // mov edx, eax
+            e.Bytes({ 0x81, 0xE2 }); e.Imm32(0x0FFF);                   // and edx, 0x0FFF
+            e.Bytes({ 0x41, 0x89, 0xC8 });                              // mov r8d, ecx
+            e.Bytes({ 0x41, 0x81, 0xE0 }); e.Imm32(0x0FFF);             // and r8d, 0x0FFF
+            e.Bytes({ 0x44, 0x01, 0xC2 });                              // add edx, r8d
+            e.Bytes({ 0xC1, 0xEA, 0x07 });                              // shr edx, 7  (bit 12 -> bit 5)
+            e.Bytes({ 0x83, 0xE2, 0x20 });                              // and edx, 0x20
+            e.Bytes({ 0x01, 0xC8 });                                    // add eax, ecx
+            e.Bytes({ 0x41, 0x89, 0xC0 });                              // mov r8d, eax
+            e.Bytes({ 0x41, 0xC1, 0xE8, 0x0C });                        // shr r8d, 12 (bit 16 -> bit 4)
+            e.Bytes({ 0x41, 0x83, 0xE0, 0x10 });                        // and r8d, 0x10
+            e.Bytes({ 0x44, 0x09, 0xC2 });                              // or edx, r8d
+            e.StoreR16(offPair[2], AL);                                 // HL = ax
+            e.MovzxR32M8(CL, offF);
+            e.Bytes({ 0x83, 0xE1, 0x80 });                              // and ecx, Z
+            e.Bytes({ 0x09, 0xD1 });                                    // or ecx, edx
+            e.StoreR8(offF, CL);
+        }
+        else if (x == 0 && z == 3)
+        {
+            // INC rr / DEC rr (no flags)
+            const bool dec = (y & 1) != 0;
+            e.Bytes({ 0x66, 0xFF }); e.Mem(dec ? 1 : 0, offPair[y >> 1]); // inc/dec word [rbx+rr]
+        }
+        else if (opcode == 0x2F)
+        {
+            // CPL
+            e.Byte(0xF6); e.Mem(2, offA);                               // not byte [rbx+A]
+            e.Group1M8(1, offF, 0x60);                                  // or F, N|H
+        }
+        else if (opcode == 0x37)
+        {
+            // SCF
+            e.Group1M8(4, offF, 0x80);                                  // and F, Z
+            e.Group1M8(1, offF, 0x10);                                  // or F, C
+        }
+        else if (opcode == 0x3F)
+        {
+            // CCF
+            e.Group1M8(4, offF, 0x90);                                  // and F, Z|C
+            e.Group1M8(6, offF, 0x10);                                  // xor F, C
+        }
+        // NOP emits nothing
+    }
+
+    // Block ended on a length or region limit rather than a branch
+    advanceClock(cycles - advanced, false);
+    e.StoreImm16(offPC, pc);
+    e.Byte(0xB8); e.Imm32(cycles);
+    e.Epilogue();
+    out = e.Position();
+    return !e.Overflowed();
+}
+
+#else
+
+Jit::Jit(CPU* cpu, BlockCache* blockCache, const DecodedHandler* handlers)
+    : cpu(cpu), blockCache(blockCache), handlers(handlers)
+{
+}
+
+Jit::~Jit() = default;
+
+void Jit::Flush()
+{
+    blockCache->DropNativeCode();
+}
+
+bool Jit::Compile(Block&)
+{
+    return false;
+}
+
+#endif
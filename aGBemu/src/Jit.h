@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class CPU;
+class BlockCache;
+struct Block;
+
+// x86-64 recompiler for hot ROM blocks. Sits on top of BlockCache: a block
+// that has run kHotThreshold times is translated into native code and its
+// Block::native pointer is set; invalidated blocks simply stop being looked up.
+//
+// Register/immediate loads, 8-bit ALU ops, INC/DEC and 16-bit register
+// arithmetic are emitted inline, with Z/H/C taken from the host flags.
+// Everything that touches memory (and therefore possibly IO), the stack, or
+// control flow calls the interpreter's handler for that opcode instead.
+// Cycles are summed at compile time and returned at each block exit; the
+// scheduler clock is advanced inline before every interpreter call and at
+// each exit, so devices observe the same time as in the interpreter. Blocks
+// only run natively when they end before the next scheduled event, and leave
+// early after any interpreter call that makes an interrupt due.
+// Native code works on an eager F: lazy flags are materialized on entry and
+// after any fallback that leaves them pending.
+// There is no block linking: every block returns to CPU::StepBlock, which
+// re-enters it directly only when it loops to itself. The gain over the
+// block cache is therefore small on short blocks and on code that is mostly
+// loads, stores and jumps, which all go through the handlers.
+class Jit
+{
+public:
+    using DecodedHandler = int (*)(CPU&, uint16_t operand);
+
+    static constexpr uint32_t kHotThreshold = 32;
+    static constexpr size_t kCodeCacheSize = 4 * 1024 * 1024;
+
+    Jit(CPU* cpu, BlockCache* blockCache, const DecodedHandler* handlers);
+    ~Jit();
+
+    // False on hosts without an x86-64 backend (the 32-bit build)
+    static bool IsSupported();
+
+    // Translate a block; false if it is not eligible (RAM code) or the
+    // translation does not fit even after flushing the code cache
+    bool Compile(Block& block);
+
+    // Drop all native code (code cache full, ROM reload)
+    void Flush();
+
+    size_t GetCodeBytesUsed() const { return used; }
+    uint32_t GetCompiledBlockCount() const { return compiledBlocks; }
+
+private:
+    CPU* cpu;
+    BlockCache* blockCache;
+    const DecodedHandler* handlers;
+
+    uint8_t* code = nullptr;
+    size_t used = 0;
+    uint32_t compiledBlocks = 0;
+
+    // Offsets of CPU state from the CPU pointer held in rbx
+    int32_t offReg[8] = {}; // B,C,D,E,H,L,-,A (opcode register encoding)
+    int32_t offF = 0;
+    int32_t offSP = 0;
+    int32_t offPair[4] = {}; // BC,DE,HL,SP (opcode pair encoding)
+    int32_t offPC = 0;
+    int32_t offFlagOp = 0;
+
+    // Called after a fallback that left lazy flags pending, before inline code touches F
+    static int SyncFlags(CPU& cpu, uint16_t);
+    // Called when the inline clock update reaches the next scheduled event
+    static int RunEvents(CPU& cpu, uint16_t);
+
+    bool Translate(Block& block, uint8_t*& out, uint8_t* limit);
+};
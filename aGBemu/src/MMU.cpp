@@ -1,98 +1,405 @@
 #include "MMU.h"
 #include "PPU.h"
+#include "BlockCache.h"
 #include <cstring>
 #include <iostream>
-#include <fstream>
+#include <string>
+#include <vector>
 
-MMU::MMU(PPU* ppu) : ppu(ppu)
+MMU::MMU(PPU* ppu) : ppu(ppu), readSlow(&ReadSlow<PlainAccess>), writeSlow(&WriteSlow<PlainAccess>)
 {
-    std::memset(rom, 0, sizeof(rom));
-    std::memset(wram, 0, sizeof(wram));
-    std::memset(hram, 0, sizeof(hram));
-    std::memset(io, 0, sizeof(io));
+    ppu->AttachMemory(memory.vram, memory.oam);
+    ppu->Connect(scheduler, interrupts, io);
     romLoaded = false;
     romLoadGeneration = 0;
+    cartridge.SetScheduler(&scheduler);
+    RegisterIO();
+    Reset();
 }
 
-// --- 8-bit memory access ---
-uint8_t MMU::Read8(uint16_t addr)
+// Null pointers leave the pages to the handlers
+void MMU::MapPages(uint8_t firstPage, int count, const uint8_t* read, uint8_t* write)
 {
-    if (addr <= 0x7FFF)
-        return rom[addr]; // ROM
+    for (int i = 0; i < count; i++)
+    {
+        MapRead(static_cast<uint8_t>(firstPage + i), read ? read + (i << 8) : nullptr);
+        MapWrite(static_cast<uint8_t>(firstPage + i), write ? write + (i << 8) : nullptr);
+    }
+}
 
-    if (addr >= 0x8000 && addr <= 0x9FFF)
-        return ppu->ReadVRAM(addr - 0x8000);
+// Direct mappings for everything with plain storage behind it
+void MMU::MapMemory()
+{
+    // VRAM writes go to the PPU, which keeps the tiles decoded and notices
+    // when the picture changes
+    MapPages(0x80, 0x20, memory.vram, nullptr);
+    MapPages(0xC0, 0x20, memory.wram, memory.wram);
+    MapPages(0xE0, 0x1E, memory.wram, memory.wram); // echo of C000-DDFF
+    for (int page = 0xC0; page <= 0xDF; page++)
+        if (codePages[page])
+            SetCodePage(static_cast<uint8_t>(page), true);
+    MapCartridge();
+}
 
-    if (addr >= 0xFE00 && addr <= 0xFE9F)
-        return ppu->ReadOAM(addr - 0xFE00);
+// ROM writes go to the bank controller, so ROM pages are never writable and
+// a ROM bank switch only rewrites the read pointers of its 64 pages
+void MMU::MapCartridge(uint8_t changed)
+{
+    if (oamDmaActive)
+        return; // remapped in full when the transfer ends
+    if (changed & Cartridge::MAP_ROM0)
+    {
+        const uint8_t* bank = cartridge.GetROMBank0();
+        for (int i = 0; i < 0x40; i++)
+            MapRead(static_cast<uint8_t>(i), bank + (i << 8));
+    }
+    if (changed & Cartridge::MAP_ROMX)
+    {
+        const uint8_t* bank = cartridge.GetROMBankX();
+        for (int i = 0; i < 0x40; i++)
+            MapRead(static_cast<uint8_t>(0x40 + i), bank + (i << 8));
+    }
+    if (changed & Cartridge::MAP_RAM)
+        MapCartridgeRAM();
+
+    // Blocks are keyed by bank, so only the one running has to stop
+    if (blockCache)
+        blockCache->OnBankSwitch();
+}
+
+// With a save attached, clean RAM pages are read-only so that their first
+// write goes through WriteHandler and marks them dirty
+void MMU::MapCartridgeRAM()
+{
+    if (oamDmaActive)
+        return;
+    uint8_t* ram = cartridge.GetMappedRAM();
+    MapPages(0xA0, 0x20, ram, ram);
+    if (ram && cartridge.HasSave())
+        for (int i = 0; i < 0x20; i++)
+            if (!cartridge.IsRAMPageDirty(static_cast<uint16_t>(0xA000 + (i << 8))))
+                MapWrite(static_cast<uint8_t>(0xA0 + i), nullptr);
+}
 
-    if (addr >= 0xC000 && addr <= 0xDFFF)
-        return wram[addr - 0xC000];
+void MMU::FlushSaveRAM()
+{
+    scheduler.Cancel(EventType::SaveFlush);
+    if (cartridge.FlushSave())
+        MapCartridgeRAM();
+}
 
-    if (addr >= 0xFF80 && addr <= 0xFFFE)
-        return hram[addr - 0xFF80];
+void MMU::OnSaveFlush(void* context, uint64_t)
+{
+    static_cast<MMU*>(context)->FlushSaveRAM();
+}
 
-    if (addr >= 0xFF00 && addr <= 0xFF7F)
+// Pages holding cached code lose their direct write pointer, so writes reach
+// WriteHandler and invalidate the blocks; so does their echo above E000
+void MMU::SetCodePage(uint8_t page, bool hasCode)
+{
+    codePages[page] = hasCode;
+    if (page >= 0xC0 && page <= 0xDF && !oamDmaActive)
     {
-        uint16_t i = addr - 0xFF00;
-        switch (addr)
-        {
-        case 0xFF40: return ppu->GetLCDC();
-        case 0xFF42: return io[i]; // SCY mirror
-        case 0xFF43: return io[i]; // SCX mirror
-        case 0xFF47: return io[i]; // BGP
-        case 0xFF48: return io[i]; // OBP0
-        case 0xFF49: return io[i]; // OBP1
-        case 0xFF4A: return io[i]; // WY
-        case 0xFF4B: return io[i]; // WX
-        default:
-            return io[i];
-        }
+        uint8_t* wram = hasCode ? nullptr : &memory.wram[(page - 0xC0) << 8];
+        MapWrite(page, wram);
+        if (page <= 0xDD)
+            MapWrite(static_cast<uint8_t>(page + 0x20), wram);
+    }
+}
+
+void MMU::Reset()
+{
+    FlushSaveRAM();
+    cartridge.Reset();
+    oamDmaActive = false;
+    MapMemory();
+    // The cartridge clock keeps its time across the restart of emulated time
+    cartridge.SuspendClock();
+    scheduler.Reset();
+    cartridge.ResumeClock();
+    timers.Reset();
+    interrupts.Reset();
+    ppu->Restart();
+}
+
+// The source is read through the normal map (E000-FFFF sources read the
+// WRAM they echo), then the CPU loses every page but FF
+void MMU::StartOamDma(uint8_t sourcePage)
+{
+    // Restarting mid-transfer copies again from the new source, which has
+    // to be readable for that
+    if (oamDmaActive)
+    {
+        oamDmaActive = false;
+        MapMemory();
+    }
+
+    // Games copy their shadow OAM every frame; the PPU only hears about
+    // transfers that change something
+    const uint16_t source = static_cast<uint16_t>((sourcePage >= 0xE0 ? sourcePage - 0x20 : sourcePage) << 8);
+    uint8_t data[sizeof(memory.oam)];
+    const uint8_t* page = mappedRead[source >> 8];
+    if (!page)
+    {
+        for (uint16_t i = 0; i < 0xA0; i++)
+            data[i] = ReadHandler(static_cast<uint16_t>(source + i));
+        page = data;
     }
+    if (std::memcmp(memory.oam, page, sizeof(memory.oam)) != 0)
+    {
+        std::memcpy(memory.oam, page, sizeof(memory.oam));
+        ppu->OnOamChanged();
+    }
+
+    oamDmaActive = true;
+    MapPages(0x00, 0xFF, nullptr, nullptr);
+    if (blockCache)
+        blockCache->OnBankSwitch(); // the running block may not go on below FF00
+    scheduler.Schedule(EventType::OamDma, scheduler.Now() + kOamDmaCycles, &MMU::OnOamDmaEnd, this);
+}
+
+void MMU::OnOamDmaEnd(void* context, uint64_t)
+{
+    MMU* mmu = static_cast<MMU*>(context);
+    mmu->oamDmaActive = false;
+    mmu->MapMemory();
+}
+
+void MMU::RegisterIO()
+{
+    io.Register(0xFF46, this, nullptr, [](void* self, uint16_t, uint8_t value) { static_cast<MMU*>(self)->StartOamDma(value); });
+}
+
+// --- 8-bit memory access: pages without a direct mapping ---
+uint8_t MMU::ReadHandler(uint16_t addr)
+{
+    // Page FF first: IO polling is the most common handler access
+    if (addr >= 0xFF00)
+    {
+        if (addr < 0xFF80)
+            return io.Read(addr);
+        if (addr == 0xFFFF)
+            return interrupts.ReadIE();
+        return memory.hram[addr - 0xFF80];
+    }
+
+    // During OAM DMA the CPU only reaches its internal bus
+    if (oamDmaActive)
+        return 0xFF;
+
+    if (addr >= 0xA000 && addr <= 0xBFFF)
+        return cartridge.ReadRAM(addr);
+
+    if (addr >= 0xFE00 && addr <= 0xFE9F)
+        return memory.oam[addr - 0xFE00];
 
     return 0; // Unmapped memory returns 0
 }
 
-void MMU::Write8(uint16_t addr, uint8_t value)
+void MMU::WriteHandler(uint16_t addr, uint8_t value)
 {
-    if (addr <= 0x7FFF)
+    if (addr >= 0xFF00)
     {
-        // ROM is read-only for now; ignore writes
+        if (addr < 0xFF80)
+        {
+            io.Write(addr, value);
+        }
+        else if (addr == 0xFFFF)
+        {
+            interrupts.WriteIE(value);
+        }
+        else
+        {
+            memory.hram[addr - 0xFF80] = value;
+            if (codePages[0xFF])
+                blockCache->InvalidatePage(0xFF);
+        }
+        return;
+    }
+
+    if (oamDmaActive)
         return;
+
+    if (addr <= 0x7FFF)
+    {
+        // Bank controller registers
+        if (const uint8_t changed = cartridge.WriteControl(addr, value))
+            MapCartridge(changed);
+    }
+    else if (addr >= 0xA000 && addr <= 0xBFFF)
+    {
+        cartridge.WriteRAM(addr, value);
+        if (cartridge.HasUnsavedChanges())
+        {
+            // The page is dirty now; later writes can go straight to it
+            if (uint8_t* ram = cartridge.GetMappedRAM())
+                MapWrite(static_cast<uint8_t>(addr >> 8), ram + (addr & 0x1F00));
+            if (!scheduler.IsScheduled(EventType::SaveFlush))
+                scheduler.Schedule(EventType::SaveFlush, scheduler.Now() + kSaveFlushDelay, &MMU::OnSaveFlush, this);
+        }
     }
     else if (addr >= 0x8000 && addr <= 0x9FFF)
     {
-        ppu->WriteVRAM(addr - 0x8000, value);
+        ppu->WriteVRAM(static_cast<uint16_t>(addr - 0x8000), value);
     }
     else if (addr >= 0xFE00 && addr <= 0xFE9F)
     {
-        ppu->WriteOAM(addr - 0xFE00, value);
+        ppu->WriteOAM(static_cast<uint16_t>(addr - 0xFE00), value);
     }
-    else if (addr >= 0xC000 && addr <= 0xDFFF)
+    else if (addr >= 0xC000 && addr <= 0xFDFF)
     {
-        wram[addr - 0xC000] = value;
+        // Echo RAM writes land in the WRAM page they mirror
+        const uint16_t offset = (addr - 0xC000) & 0x1FFF;
+        const uint8_t page = static_cast<uint8_t>(0xC0 + (offset >> 8));
+        memory.wram[offset] = value;
+        if (codePages[page])
+            blockCache->InvalidatePage(page);
     }
-    else if (addr >= 0xFF80 && addr <= 0xFFFE)
+}
+
+// --- Access policies ---
+struct MMU::PlainAccess
+{
+    static constexpr bool kObserves = false;
+};
+
+struct MMU::WatchedAccess
+{
+    static constexpr bool kObserves = true;
+    static void Observe(MMU& mmu, uint16_t addr, uint8_t value, bool write)
     {
-        hram[addr - 0xFF80] = value;
+        mmu.CheckWatchpoints(addr, value, write);
+    }
+};
+
+struct MMU::TracedAccess
+{
+    static constexpr bool kObserves = true;
+    static void Observe(MMU& mmu, uint16_t addr, uint8_t value, bool write)
+    {
+        if (mmu.traceCallback)
+            mmu.traceCallback(mmu.traceContext, addr, value, write);
+    }
+};
+
+// Observed pages do the access through the memory map, then report it
+template<class Policy>
+uint8_t MMU::ReadSlow(MMU& mmu, uint16_t addr)
+{
+    if constexpr (Policy::kObserves)
+    {
+        if (mmu.readHooks[addr >> 8])
+        {
+            const uint8_t value = mmu.Peek8(addr);
+            Policy::Observe(mmu, addr, value, false);
+            return value;
+        }
     }
-    else if (addr >= 0xFF00 && addr <= 0xFF7F)
+    return mmu.ReadHandler(addr);
+}
+
+template<class Policy>
+void MMU::WriteSlow(MMU& mmu, uint16_t addr, uint8_t value)
+{
+    if constexpr (Policy::kObserves)
     {
-        uint16_t i = addr - 0xFF00;
-        io[i] = value;
-        switch (addr)
+        if (mmu.writeHooks[addr >> 8])
         {
-        case 0xFF40: ppu->SetLCDC(value); break;
-        case 0xFF42: ppu->SetSCY(value); break;
-        case 0xFF43: ppu->SetSCX(value); break;
-        case 0xFF47: ppu->SetBGP(value); break;
-        case 0xFF48: ppu->SetOBP0(value); break;
-        case 0xFF49: ppu->SetOBP1(value); break;
-        case 0xFF4A: ppu->SetWY(value); break;
-        case 0xFF4B: ppu->SetWX(value); break;
-        default: break;
+            if (uint8_t* page = mmu.mappedWrite[addr >> 8])
+                page[addr & 0xFF] = value;
+            else
+                mmu.WriteHandler(addr, value);
+            Policy::Observe(mmu, addr, value, true);
+            return;
         }
     }
+    mmu.WriteHandler(addr, value);
+}
+
+void MMU::SetAccessPolicy(AccessPolicy policy)
+{
+    accessPolicy = policy;
+    switch (policy)
+    {
+    case AccessPolicy::Plain:
+        readSlow = &ReadSlow<PlainAccess>;
+        writeSlow = &WriteSlow<PlainAccess>;
+        break;
+    case AccessPolicy::Watched:
+        readSlow = &ReadSlow<WatchedAccess>;
+        writeSlow = &WriteSlow<WatchedAccess>;
+        break;
+    case AccessPolicy::Traced:
+        readSlow = &ReadSlow<TracedAccess>;
+        writeSlow = &WriteSlow<TracedAccess>;
+        break;
+    }
+    UpdateHooks();
+}
+
+// Take the observed pages out of the page table and put the rest back
+void MMU::UpdateHooks()
+{
+    readHooks.reset();
+    writeHooks.reset();
+    if (accessPolicy == AccessPolicy::Traced)
+    {
+        readHooks.set();
+        writeHooks.set();
+    }
+    else if (accessPolicy == AccessPolicy::Watched)
+    {
+        for (const Watchpoint& w : watchpoints)
+            for (int page = w.first >> 8; page <= (w.last >> 8); page++)
+            {
+                if (w.onRead)
+                    readHooks.set(page);
+                if (w.onWrite)
+                    writeHooks.set(page);
+            }
+    }
+    for (int page = 0; page < 256; page++)
+    {
+        MapRead(static_cast<uint8_t>(page), mappedRead[page]);
+        MapWrite(static_cast<uint8_t>(page), mappedWrite[page]);
+    }
+}
+
+int MMU::AddWatchpoint(uint16_t first, uint16_t last, bool onRead, bool onWrite, AccessCallback callback, void* context)
+{
+    const int id = nextWatchpointId++;
+    watchpoints.push_back({ id, first, last, onRead, onWrite, callback, context });
+    UpdateHooks();
+    return id;
+}
+
+void MMU::RemoveWatchpoint(int id)
+{
+    for (size_t i = 0; i < watchpoints.size(); i++)
+        if (watchpoints[i].id == id)
+        {
+            watchpoints.erase(watchpoints.begin() + i);
+            UpdateHooks();
+            return;
+        }
+}
+
+void MMU::SetTraceCallback(AccessCallback callback, void* context)
+{
+    traceCallback = callback;
+    traceContext = context;
+}
+
+// The page is watched; the address may not be. Callbacks may add or remove
+// watchpoints, so each one is copied before it is called.
+void MMU::CheckWatchpoints(uint16_t addr, uint8_t value, bool write)
+{
+    for (size_t i = 0; i < watchpoints.size(); i++)
+    {
+        const Watchpoint w = watchpoints[i];
+        if (addr >= w.first && addr <= w.last && (write ? w.onWrite : w.onRead))
+            w.callback(w.context, addr, value, write);
+    }
 }
 
 // --- 16-bit convenience access ---
@@ -109,32 +416,31 @@ void MMU::Write16(uint16_t addr, uint16_t value)
     Write8(addr + 1, value >> 8);
 }
 
-// --- Load ROM from file (up to 32KB, no MBC) ---
+// game.gb -> game.sav, next to the ROM
+static std::string SavePathFor(const std::string& romPath)
+{
+    const size_t dot = romPath.find_last_of('.');
+    const size_t slash = romPath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return romPath + ".sav";
+    return romPath.substr(0, dot) + ".sav";
+}
+
+// --- Load ROM from file ---
 bool MMU::LoadROMFromFile(const char* filepath)
 {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file)
-    {
-        std::cerr << "Failed to open ROM: " << filepath << std::endl;
+    // Mapped, not read: instances loading the same game share the image
+    std::shared_ptr<const RomImage> image = RomImage::Open(filepath);
+    if (!image)
         return false;
-    }
-
-    // Read up to 32KB into rom[]
-    std::memset(rom, 0, sizeof(rom));
-    file.read(reinterpret_cast<char*>(rom), sizeof(rom));
-    std::streamsize bytesRead = file.gcount();
 
-    if (bytesRead <= 0)
-    {
-        std::cerr << "ROM read returned 0 bytes: " << filepath << std::endl;
-        return false;
-    }
+    cartridge.Load(std::move(image));
+    if (cartridge.HasBattery() && saveFilesEnabled)
+        cartridge.AttachSave(SavePathFor(filepath));
+    MapCartridge();
 
-    // If file exceeds 32KB, we currently ignore the remainder (no MBC implemented)
-    if (!file.eof())
-    {
-        std::cerr << "Warning: ROM larger than 32KB; only first 32KB loaded (no MBC)." << std::endl;
-    }
+    if (blockCache)
+        blockCache->Clear();
 
     romLoaded = true;
     romLoadGeneration++;
@@ -152,7 +458,19 @@ void MMU::LoadTestProgram()
         0xC3, 0x04, 0x01  // JP 0x0104        ; jump back to INC B
     };
 
+    std::vector<uint8_t> image(0x8000, 0);
     for (int i = 0; i < sizeof(program); ++i)
-        rom[0x0100 + i] = program[i];
+        image[0x0100 + i] = program[i];
+
+    LoadROMFromBytes(std::move(image));
+}
+
+void MMU::LoadROMFromBytes(std::vector<uint8_t> image)
+{
+    cartridge.Load(RomImage::FromBytes(std::move(image)));
+    MapCartridge();
+
+    if (blockCache)
+        blockCache->Clear();
 }
 
@@ -1,39 +1,203 @@
 #pragma once
+#include <bitset>
 #include <cstdint>
+#include <vector>
+#include "Scheduler.h"
+#include "Timers.h"
+#include "Interrupts.h"
+#include "Cartridge.h"
+#include "CoreMemory.h"
+#include "IORegisters.h"
 
 class PPU;
+class BlockCache;
+
+// How memory accesses are observed. Plain is what games run with: the page
+// table and the handlers, nothing else. Watched calls back on accesses to
+// watchpoint addresses and Traced on every access. Either way only the
+// pages being observed leave the page table, so the rest of memory keeps
+// its direct mapping.
+enum class AccessPolicy : uint8_t
+{
+    Plain,
+    Watched,
+    Traced
+};
 
 class MMU
 {
 public:
     MMU(PPU* ppu);
 
-    // 8-bit access
-    uint8_t Read8(uint16_t addr);
-    void Write8(uint16_t addr, uint8_t value);
+    // Power-on state of the clock, timers and interrupt registers
+    void Reset();
+
+    // 8-bit access: plain memory is one page-table lookup; IO, OAM,
+    // unmapped and observed pages (and VRAM writes) go through the access
+    // policy
+    uint8_t Read8(uint16_t addr)
+    {
+        if (const uint8_t* page = readPages[addr >> 8])
+            return page[addr & 0xFF];
+        return readSlow(*this, addr);
+    }
+    void Write8(uint16_t addr, uint8_t value)
+    {
+        if (uint8_t* page = writePages[addr >> 8])
+            page[addr & 0xFF] = value;
+        else
+            writeSlow(*this, addr, value);
+    }
+
+    // Read that observers never see, for instruction decoders and the debugger
+    uint8_t Peek8(uint16_t addr)
+    {
+        if (const uint8_t* page = mappedRead[addr >> 8])
+            return page[addr & 0xFF];
+        return ReadHandler(addr);
+    }
+    uint16_t Peek16(uint16_t addr) { return static_cast<uint16_t>(Peek8(addr) | (Peek8(addr + 1) << 8)); }
 
     // 16-bit access (convenience for CPU instructions)
     uint16_t Read16(uint16_t addr);
     void Write16(uint16_t addr, uint16_t value);
 
-    // Load ROM image into fixed 32KB ROM (no MBC yet)
+    // Load a cartridge image; the header selects the bank controller
     bool LoadROMFromFile(const char* filepath);
     bool IsROMLoaded() const { return romLoaded; }
     uint32_t GetROMLoadGeneration() const { return romLoadGeneration; }
     
     // Load a tiny in-memory test program at 0x0100 (dev only)
     void LoadTestProgram();
+    // Load a cartridge image built in memory (generated test ROMs; dev only)
+    void LoadROMFromBytes(std::vector<uint8_t> image);
+
+    // Off: battery RAM is not loaded from or saved to a .sav (scratch
+    // instances such as benchmarks). Takes effect on the next load.
+    void SetSaveFilesEnabled(bool enabled) { saveFilesEnabled = enabled; }
+
+    // Queue the battery RAM pages written since the last flush (and the
+    // cartridge clock) for saving. Runs by itself about once a second while
+    // the game writes to its RAM.
+    void FlushSaveRAM();
+
+    // ROM bank currently mapped at addr (0x0000-0x7FFF)
+    uint16_t GetROMBank(uint16_t addr) const { return cartridge.GetBankNumber(addr); }
+    Cartridge& GetCartridge() { return cartridge; }
+
+    // True while an OAM DMA transfer has the bus (see StartOamDma)
+    bool IsOamDmaActive() const { return oamDmaActive; }
+
+    // Memory observation (see AccessPolicy); can be switched at any time.
+    // Callbacks run after the access with the value read or written.
+    using AccessCallback = void (*)(void* context, uint16_t addr, uint8_t value, bool write);
+    void SetAccessPolicy(AccessPolicy policy);
+    AccessPolicy GetAccessPolicy() const { return accessPolicy; }
+
+    // Watch first..last inclusive; fires under AccessPolicy::Watched only.
+    // Returns an id for RemoveWatchpoint.
+    int AddWatchpoint(uint16_t first, uint16_t last, bool onRead, bool onWrite, AccessCallback callback, void* context);
+    void RemoveWatchpoint(int id);
+
+    // Called for every access under AccessPolicy::Traced
+    void SetTraceCallback(AccessCallback callback, void* context);
+
+    Scheduler& GetScheduler() { return scheduler; }
+    Interrupts& GetInterrupts() { return interrupts; }
+
+    // Block cache hooks: writes to a page marked as holding cached code
+    // invalidate the blocks decoded from it
+    void SetBlockCache(BlockCache* cache) { blockCache = cache; }
+    void SetCodePage(uint8_t page, bool hasCode);
 
 private:
+    // WRAM, VRAM, OAM, IO and HRAM; first so that it starts the object
+    CoreMemory memory = {};
     PPU* ppu;
+    IORegisters io{ memory.io }; // FF00-FF7F, claimed by the devices
+
+    // Memory map: per 256-byte page, the storage backing it. A null entry
+    // sends the access to ReadHandler/WriteHandler. Switching a bank only
+    // repoints its pages.
+    const uint8_t* mappedRead[256] = {};
+    uint8_t* mappedWrite[256] = {};
+    void MapPages(uint8_t firstPage, int count, const uint8_t* read, uint8_t* write);
+    void MapMemory();
+    void MapCartridge(uint8_t changed = Cartridge::MAP_ALL); // Cartridge::MapChange bits
+    void MapCartridgeRAM();
+    uint8_t ReadHandler(uint16_t addr);
+    void WriteHandler(uint16_t addr, uint8_t value);
+
+    // Page table the accessors use: the memory map minus the pages the
+    // access policy observes. Map changes go through MapRead/MapWrite to
+    // keep the two in step.
+    const uint8_t* readPages[256] = {};
+    uint8_t* writePages[256] = {};
+    std::bitset<256> readHooks;
+    std::bitset<256> writeHooks;
+    void MapRead(uint8_t page, const uint8_t* data)
+    {
+        mappedRead[page] = data;
+        readPages[page] = readHooks[page] ? nullptr : data;
+    }
+    void MapWrite(uint8_t page, uint8_t* data)
+    {
+        mappedWrite[page] = data;
+        writePages[page] = writeHooks[page] ? nullptr : data;
+    }
+
+    // Access policies: each instantiation of ReadSlow/WriteSlow compiles in
+    // only what its policy observes, so Plain is the bare handlers
+    struct PlainAccess;
+    struct WatchedAccess;
+    struct TracedAccess;
+    template<class Policy> static uint8_t ReadSlow(MMU& mmu, uint16_t addr);
+    template<class Policy> static void WriteSlow(MMU& mmu, uint16_t addr, uint8_t value);
+    uint8_t (*readSlow)(MMU& mmu, uint16_t addr);
+    void (*writeSlow)(MMU& mmu, uint16_t addr, uint8_t value);
+    AccessPolicy accessPolicy = AccessPolicy::Plain;
+    void UpdateHooks();
+
+    struct Watchpoint
+    {
+        int id;
+        uint16_t first, last;
+        bool onRead, onWrite;
+        AccessCallback callback;
+        void* context;
+    };
+    std::vector<Watchpoint> watchpoints;
+    int nextWatchpointId = 1;
+    void CheckWatchpoints(uint16_t addr, uint8_t value, bool write);
+    AccessCallback traceCallback = nullptr;
+    void* traceContext = nullptr;
+
+    Cartridge cartridge;
+    Scheduler scheduler;
+    Interrupts interrupts{ io }; // IF/IE
+    Timers timers{ scheduler, interrupts, io };
+
+    // DMA register (the PPU claims its own)
+    void RegisterIO();
+
+    // Battery RAM is saved this long after its first unsaved write
+    static constexpr uint32_t kSaveFlushDelay = 4194304; // 1 s
+    static void OnSaveFlush(void* context, uint64_t when);
+
+    // OAM DMA (FF46). The 160 bytes are copied the moment the transfer
+    // starts; for the 160 M-cycles it takes, every page is unmapped and
+    // the handlers keep the CPU to FF00-FFFF (IO and HRAM).
+    static constexpr uint32_t kOamDmaCycles = 160 * 4;
+    bool oamDmaActive = false;
+    void StartOamDma(uint8_t sourcePage);
+    static void OnOamDmaEnd(void* context, uint64_t when);
 
-    // Memory arrays
-    uint8_t rom[0x8000];   // 32 KB ROM
-    uint8_t wram[0x2000];  // 8 KB Work RAM
-    uint8_t hram[0x7F];    // High RAM
-    uint8_t io[0x80];      // IO registers
+    // Cached-code tracking (see BlockCache)
+    BlockCache* blockCache = nullptr;
+    bool codePages[256] = {};
 
     // ROM load state
+    bool saveFilesEnabled = true;
     bool romLoaded = false;
     uint32_t romLoadGeneration = 0; // increments each successful load
 };
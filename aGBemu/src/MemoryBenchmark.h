@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+// Dev-only microbenchmark of MMU::Read8/Write8. Runs on a private PPU/MMU
+// pair so it can be started while a game is loaded without disturbing it.
+struct MemoryBenchmarkResult
+{
+    // Nanoseconds per access
+    double romRead = 0;
+    double wramRead = 0;
+    double wramWrite = 0;
+    double vramWrite = 0;
+    double hramRead = 0;  // handler page (IO/HRAM/IE)
+    double ioRead = 0;    // LY polling (FF44)
+    double ioWrite = 0;   // scroll/palette register writes
+    double mixed = 0;     // fetch-like pattern over ROM, WRAM and HRAM
+};
+
+MemoryBenchmarkResult RunMemoryBenchmark(uint32_t accesses = 1u << 24);
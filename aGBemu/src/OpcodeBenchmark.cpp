@@ -0,0 +1,240 @@
+#include "OpcodeBenchmark.h"
+#include "DevCore.h"
+#include "Jit.h"
+#include "Opcodes.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    constexpr uint16_t kLoopStart = 0x0150;
+    constexpr int kLoopLength = 1024; // instructions
+
+    bool IsRegisterOnly(uint8_t opcode)
+    {
+        const std::string_view name = kOpcodeTable[opcode].mnemonic;
+        return !EndsBasicBlock(opcode) && !IsIllegalOpcode(opcode) && opcode != 0xCB &&
+               name.find('(') == std::string_view::npos && name.find("SP") == std::string_view::npos;
+    }
+
+    struct Program
+    {
+        std::vector<uint8_t> image;
+        double cyclesPerInstruction = 0;
+    };
+
+    // Fixed-seed loop of kLoopLength instructions then JP back. `emit`
+    // writes one instruction at pc and returns its cycles; `setup` runs
+    // once before the loop.
+    template<typename Emit>
+    Program GenerateProgram(std::initializer_list<uint8_t> setup, Emit emit)
+    {
+        std::mt19937 rng(1);
+        Program program;
+        program.image.assign(0x8000, 0);
+        std::vector<uint8_t>& image = program.image;
+        uint16_t pc = 0x0100;
+        for (uint8_t byte : setup)
+            image[pc++] = byte;
+        for (uint8_t byte : { uint8_t(0xC3), uint8_t(kLoopStart & 0xFF), uint8_t(kLoopStart >> 8) })
+            image[pc++] = byte;
+
+        pc = kLoopStart;
+        uint32_t cycles = 0;
+        for (int i = 0; i < kLoopLength; i++)
+            cycles += emit(rng, image.data(), pc);
+        image[pc++] = 0xC3; // JP loop
+        image[pc++] = kLoopStart & 0xFF;
+        image[pc++] = kLoopStart >> 8;
+        cycles += kOpcodeTable[0xC3].cycles;
+        program.cyclesPerInstruction = double(cycles) / (kLoopLength + 1);
+        return program;
+    }
+
+    Program GenerateBaseProgram()
+    {
+        return GenerateProgram({}, [](std::mt19937& rng, uint8_t* image, uint16_t& pc) {
+            uint8_t opcode;
+            do
+                opcode = static_cast<uint8_t>(rng());
+            while (!IsRegisterOnly(opcode));
+            image[pc++] = opcode;
+            for (int j = 1; j < kOpcodeTable[opcode].length; j++)
+                image[pc++] = static_cast<uint8_t>(rng());
+            return kOpcodeTable[opcode].cycles;
+        });
+    }
+
+    // Every CB operation on B, C, D, E, A and (HL), with HL left in WRAM
+    Program GenerateCBProgram()
+    {
+        return GenerateProgram({ 0x21, 0x00, 0xC8 }, [](std::mt19937& rng, uint8_t* image, uint16_t& pc) { // LD HL,C800
+            uint8_t cb;
+            do
+                cb = static_cast<uint8_t>(rng());
+            while ((cb & 7) == 4 || (cb & 7) == 5);
+            image[pc++] = 0xCB;
+            image[pc++] = cb;
+            return kCBOpcodeTable[cb].cycles;
+        });
+    }
+
+    double InstructionsPerMicrosecond(const Program& program, uint32_t frames, ExecutionMode mode)
+    {
+        auto emulator = MakeScratchCore(program.image, mode);
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++)
+            emulator->RunFrame();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const double instructions = frames * double(Emulator::kCyclesPerFrame) / program.cyclesPerInstruction;
+        return instructions / std::chrono::duration<double, std::micro>(elapsed).count();
+    }
+
+    OpcodeBenchmarkResult Measure(const Program& program, uint32_t frames)
+    {
+        OpcodeBenchmarkResult result;
+        {
+            auto emulator = MakeScratchCore(program.image, ExecutionMode::Interpreter);
+            CPU& cpu = emulator->GetCPU();
+            const uint64_t steps = static_cast<uint64_t>(frames * double(Emulator::kCyclesPerFrame) / program.cyclesPerInstruction);
+            const auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < steps; i++)
+                cpu.Step();
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            result.step = steps / std::chrono::duration<double, std::micro>(elapsed).count();
+        }
+        result.interpreter = InstructionsPerMicrosecond(program, frames, ExecutionMode::Interpreter);
+        result.blockCache = InstructionsPerMicrosecond(program, frames, ExecutionMode::BlockCache);
+        if (Jit::IsSupported())
+            result.jit = InstructionsPerMicrosecond(program, frames, ExecutionMode::Jit);
+        return result;
+    }
+
+    // Hardware behaviour of a CB instruction on `value`, worked out here
+    // rather than taken from the CPU or kCBOpcodeTable
+    struct CBOutcome
+    {
+        uint8_t value;
+        uint8_t flags;
+        int cycles;
+    };
+
+    CBOutcome ReferenceCB(uint8_t cb, uint8_t value, uint8_t flags)
+    {
+        const int x = cb >> 6;
+        const int y = (cb >> 3) & 7;
+        const bool memory = (cb & 7) == 6;
+        const int carryIn = (flags >> 4) & 1;
+        if (x == 1) // BIT: Z from the bit, N clear, H set, C kept
+            return { value, static_cast<uint8_t>((value & (1 << y) ? 0 : 0x80) | 0x20 | (flags & 0x10)), memory ? 12 : 8 };
+        if (x == 2) // RES, SET: flags untouched
+            return { static_cast<uint8_t>(value & ~(1 << y)), flags, memory ? 16 : 8 };
+        if (x == 3)
+            return { static_cast<uint8_t>(value | (1 << y)), flags, memory ? 16 : 8 };
+
+        int result = 0;
+        bool carry = false;
+        switch (y)
+        {
+        case 0: result = (value << 1) | (value >> 7); carry = value & 0x80; break;  // RLC
+        case 1: result = (value >> 1) | (value << 7); carry = value & 0x01; break;  // RRC
+        case 2: result = (value << 1) | carryIn; carry = value & 0x80; break;       // RL
+        case 3: result = (value >> 1) | (carryIn << 7); carry = value & 0x01; break; // RR
+        case 4: result = value << 1; carry = value & 0x80; break;                    // SLA
+        case 5: result = (value >> 1) | (value & 0x80); carry = value & 0x01; break; // SRA
+        case 6: result = (value << 4) | (value >> 4); break;                         // SWAP
+        default: result = value >> 1; carry = value & 0x01; break;                   // SRL
+        }
+        const uint8_t res = static_cast<uint8_t>(result);
+        return { res, static_cast<uint8_t>((res == 0 ? 0x80 : 0) | (carry ? 0x10 : 0)), memory ? 16 : 8 };
+    }
+}
+
+OpcodeBenchmarkResult RunOpcodeBenchmark(uint32_t frames)
+{
+    return Measure(GenerateBaseProgram(), frames);
+}
+
+OpcodeBenchmarkResult RunCBOpcodeBenchmark(uint32_t frames)
+{
+    return Measure(GenerateCBProgram(), frames);
+}
+
+std::string CheckCBOpcodes()
+{
+    // Each case is set up and run from WRAM: F and A through PUSH/POP, the
+    // other pairs loaded, then the CB instruction, then back to C000.
+    // Registers other than the operand hold fixed values; (HL) is D000 and
+    // holds the operand value too.
+    constexpr uint16_t kCode = 0xC000;
+    constexpr uint16_t kOperand = 0xD000;
+    constexpr uint8_t kRegisters[8] = { 0x12, 0x34, 0x56, 0x78, kOperand >> 8, kOperand & 0xFF, 0, 0x9A }; // B C D E H L - A
+    constexpr int kSetupInstructions = 7;
+
+    std::vector<uint8_t> image(0x8000, 0);
+    image[0x0100] = 0xC3; // JP C000
+    image[0x0101] = kCode & 0xFF;
+    image[0x0102] = kCode >> 8;
+    auto emulator = MakeScratchCore(std::move(image), ExecutionMode::Interpreter);
+    CPU& cpu = emulator->GetCPU();
+    MMU& mmu = emulator->GetMMU();
+    cpu.Step();
+
+    for (int cb = 0; cb < 256; cb++)
+    {
+        const int target = cb & 7;
+        if (kCBOpcodeTable[cb].cycles != ReferenceCB(static_cast<uint8_t>(cb), 0, 0).cycles)
+            return std::string("kCBOpcodeTable has the wrong cycles for ") + kCBOpcodeTable[cb].mnemonic;
+
+        for (int value = 0; value < 256; value++)
+        {
+            for (uint8_t flags : { 0x00, 0x10, 0xE0, 0xF0 })
+            {
+                uint8_t regs[8];
+                std::copy(std::begin(kRegisters), std::end(kRegisters), regs);
+                regs[6] = regs[target] = static_cast<uint8_t>(value);
+                const uint8_t code[] = {
+                    0x31, 0xF0, 0xDF,             // LD SP,DFF0
+                    0x01, flags, regs[7],         // LD BC,AF
+                    0xC5, 0xF1,                   // PUSH BC; POP AF
+                    0x01, regs[1], regs[0],       // LD BC
+                    0x11, regs[3], regs[2],       // LD DE
+                    0x21, regs[5], regs[4],       // LD HL
+                    0xCB, static_cast<uint8_t>(cb),
+                    0xC3, kCode & 0xFF, kCode >> 8 // JP C000
+                };
+                for (size_t i = 0; i < sizeof(code); i++)
+                    mmu.Write8(static_cast<uint16_t>(kCode + i), code[i]);
+                mmu.Write8(kOperand, static_cast<uint8_t>(value));
+
+                for (int i = 0; i < kSetupInstructions; i++)
+                    cpu.Step();
+                const uint64_t start = mmu.GetScheduler().Now();
+                const int cycles = cpu.Step();
+                const uint64_t elapsed = mmu.GetScheduler().Now() - start;
+
+                const CBOutcome expected = ReferenceCB(static_cast<uint8_t>(cb), static_cast<uint8_t>(value), flags);
+                regs[target] = expected.value;
+                const CPU::Registers r = cpu.GetRegisters();
+                const uint8_t actual[8] = { r.B, r.C, r.D, r.E, r.H, r.L, mmu.Peek8(kOperand), r.A };
+                const bool same = std::equal(std::begin(actual), std::end(actual), std::begin(regs));
+                if (!same || r.F != expected.flags || cycles != expected.cycles || elapsed != uint64_t(cycles))
+                {
+                    char text[128];
+                    std::snprintf(text, sizeof(text), "%s on %02X with F=%02X: result %s, F %02X (expected %02X), %d cycles (expected %d)",
+                                  kCBOpcodeTable[cb].mnemonic, value, flags, same ? "ok" : "wrong", r.F, expected.flags,
+                                  cycles, expected.cycles);
+                    return text;
+                }
+                cpu.Step(); // JP C000
+            }
+        }
+    }
+    return {};
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Dev-only benchmark of opcode dispatch: a long loop of register-only
+// base-page instructions (loads, ALU, INC/DEC, rotates, 16-bit arithmetic;
+// no memory operands, so the MMU stays out of it) run on a private
+// Emulator. The interpreter figure times CPU::Step on its own; the others
+// run whole frames, with the instruction count derived from the cycles.
+struct OpcodeBenchmarkResult
+{
+    // Millions of instructions per host second; 0 when the mode is not available
+    double step = 0;        // CPU::Step in a loop, interpreter
+    double interpreter = 0; // RunFrame, interpreter
+    double blockCache = 0;
+    double jit = 0;
+};
+
+OpcodeBenchmarkResult RunOpcodeBenchmark(uint32_t frames = 1200);
+
+// The same measurements on a loop of CB-prefixed instructions: every
+// rotate, shift, BIT, RES and SET on B, C, D, E, A and (HL)
+OpcodeBenchmarkResult RunCBOpcodeBenchmark(uint32_t frames = 1200);
+
+// All 256 CB opcodes on every operand value and several incoming flag
+// combinations, each checked against a reference model of the hardware:
+// result, F, the other registers, and the cycles (as returned by Step, as
+// advanced on the clock and as listed in kCBOpcodeTable). The first
+// mismatch, or empty when there is none.
+std::string CheckCBOpcodes();
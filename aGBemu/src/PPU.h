@@ -1,16 +1,54 @@
 #pragma once
 #include <cstdint>
+#include <memory>
+#include "PixelKernels.h"
 
+class Scheduler;
+class Interrupts;
+class IORegisters;
+
+// Scanline PPU. The LCD runs through OAM scan, drawing and HBlank on each of
+// lines 0-143 and VBlank on lines 144-153, one scheduled event per mode
+// change rather than a step per cycle. Each line is drawn when its drawing
+// mode ends, with the registers as they are at that moment, so mid-frame
+// scroll and palette effects show up. Lines go to a back buffer that is
+// swapped in at VBlank, so the host always sees a whole frame.
 class PPU {
 public:
     PPU();
     void Reset();
 
-    // Render the full screen to the framebuffer (background + sprites)
-    void RenderFrame();
+    // VRAM and OAM live in the MMU's CoreMemory; the MMU hands them over
+    // when it is constructed
+    void AttachMemory(uint8_t* vram, uint8_t* oam);
+
+    // The owning MMU's clock, interrupt controller and IO table. Claims
+    // LCDC, STAT, SCY, SCX, LY, LYC, BGP, OBP0, OBP1, WY and WX.
+    void Connect(Scheduler& scheduler, Interrupts& interrupts, IORegisters& io);
+
+    // The clock was reset: start the timeline over at line 0 if the LCD is on
+    void Restart();
+
+    // Return framebuffer for renderer (the last complete frame), nullptr
+    // while disabled. One RGBA32 value per pixel, R in the low byte
+    // (GL_RGBA with GL_UNSIGNED_INT_8_8_8_8_REV).
+    uint32_t* GetFramebuffer();
+
+    // Headless instances (tests, batch runs) can drop the framebuffers; the
+    // timeline, LY/STAT and interrupts run the same without them
+    void SetFramebufferEnabled(bool enabled);
+    bool IsFramebufferEnabled() const { return framebuffer != nullptr; }
+
+    // Frames completed (VBlanks entered) since power-on
+    uint32_t GetFrameCount() const { return frameCount; }
+
+    // Changes whenever the framebuffer gets a new picture: the same value
+    // means the same pixels, so the host can skip uploading it again
+    uint32_t GetFrameSerial() const { return frameSerial; }
 
-    // Return framebuffer for renderer
-    uint8_t* GetFramebuffer();
+    // Completed frames that were not drawn because nothing they depend on
+    // had changed since the previous one
+    uint32_t GetUnchangedFrameCount() const { return unchangedFrames; }
 
     // --- NEW: VRAM / OAM access for MMU ---
     uint8_t ReadVRAM(uint16_t addr);
@@ -19,26 +57,45 @@ public:
     uint8_t ReadOAM(uint16_t addr);
     void WriteOAM(uint16_t addr, uint8_t value);
 
+    // VRAM backing store. Reads go straight to it through the MMU's page
+    // table; writes come through WriteVRAM so the decoded tiles and the
+    // unchanged-frame check stay current.
+    uint8_t* GetVRAM() { return vram; }
+
+    // OAM backing store, filled in one go by OAM DMA, which then calls
+    // OnOamChanged if the contents differ
+    uint8_t* GetOAM() { return oam; }
+    void OnOamChanged() { contentGeneration++; }
+
     // IO register accessors
-    void SetLCDC(uint8_t value) { lcdc = value; }
+    void SetLCDC(uint8_t value);
     uint8_t GetLCDC() const { return lcdc; }
-    void SetSCY(uint8_t value) { scy = value; }
-    void SetSCX(uint8_t value) { scx = value; }
+    void SetSTAT(uint8_t value);
+    uint8_t GetSTAT() const;
+    void SetSCY(uint8_t value) { SetDisplayRegister(scy, value); }
+    void SetSCX(uint8_t value) { SetDisplayRegister(scx, value); }
+    void SetLYC(uint8_t value);
     void SetBGP(uint8_t value);
     void SetOBP0(uint8_t value);
     void SetOBP1(uint8_t value);
-    void SetWY(uint8_t value) { wy = value; }
-    void SetWX(uint8_t value) { wx = value; }
+    void SetWY(uint8_t value) { SetDisplayRegister(wy, value); }
+    void SetWX(uint8_t value) { SetDisplayRegister(wx, value); }
+    uint8_t GetLY() const { return ly; }
 
 private:
-    // GameBoy framebuffer: 160x144 RGB
-    uint8_t framebuffer[160 * 144 * 3];
+    // GameBoy framebuffer: 160x144 RGBA32, front (complete) and back (being drawn)
+    static constexpr size_t kFramebufferPixels = 160 * 144;
+    std::unique_ptr<uint32_t[]> framebuffer;
+    std::unique_ptr<uint32_t[]> backBuffer;
 
-    // VRAM (tiles + tile maps)
-    uint8_t vram[0x2000]; // 8 KB
+    // VRAM (tiles + tile maps), 8 KB
+    uint8_t* vram = nullptr;
 
-    // OAM (sprites)
-    uint8_t oam[0xA0]; // 40 sprites � 4 bytes
+    // OAM (sprites), 40 sprites × 4 bytes
+    uint8_t* oam = nullptr;
+
+    Scheduler* scheduler = nullptr;
+    Interrupts* interrupts = nullptr;
 
     // LCDC registers
     uint8_t lcdc; // LCD control
@@ -46,25 +103,83 @@ private:
     uint8_t scy;  // Scroll Y
     uint8_t wy = 0; // Window Y
     uint8_t wx = 0; // Window X (minus 7 when drawing)
+    uint8_t ly = 0; // Current scanline
+    uint8_t lyc = 0; // LY compare
+    uint8_t statEnables = 0; // STAT bits 3-6, the interrupt sources
 
     // DMG palette registers (BGP/OBP0/OBP1)
     uint8_t bgpReg = 0xE4;  // default: 11 10 01 00
     uint8_t obp0Reg = 0xE4;
     uint8_t obp1Reg = 0xE4;
 
-    // Palette (4 shades for background)
-    uint8_t palette[4][3]; // RGB for each color
+    // The four DMG shades, lightest first, as packed RGBA32
+    static constexpr uint32_t kShades[4] = { 0xFFFFFFFF, 0xFFC0C0C0, 0xFF606060, 0xFF000000 };
+
+    // Color index to pixel through BGP and OBP0/OBP1, rebuilt when the
+    // register is written so drawing a pixel is one lookup and one store
+    uint32_t bgColors[4];
+    uint32_t objColors[2][4];
+    static void BuildColors(uint8_t paletteReg, uint32_t colors[4]);
 
-    // Sprite palettes (OBP0 and OBP1)
-    uint8_t spritePalette[2][4][3];
+    // Mode timeline. Modes are STAT's numbering.
+    enum Mode : uint8_t { MODE_HBLANK = 0, MODE_VBLANK = 1, MODE_OAM_SCAN = 2, MODE_DRAWING = 3 };
+    static constexpr uint32_t kOamScanCycles = 80;
+    static constexpr uint32_t kDrawingCycles = 172; // no sprite or scroll penalties
+    static constexpr uint32_t kHBlankCycles = 204;
+    static constexpr uint32_t kCyclesPerLine = kOamScanCycles + kDrawingCycles + kHBlankCycles;
+    Mode mode = MODE_HBLANK;
+    bool statLine = false;  // OR of the enabled STAT conditions; the interrupt fires on its rising edge
+    uint8_t windowLine = 0; // lines of the window drawn so far this frame
+    uint32_t frameCount = 0;
+    void EnterMode(Mode next, uint64_t when, uint32_t duration);
+    static void OnModeEnd(void* context, uint64_t when);
+    void UpdateStatLine();
+
+    // The 384 tiles at 8000-97FF decoded to one color index per pixel,
+    // plus every row mirrored for X-flipped sprites, so the renderers copy
+    // 8-pixel rows instead of pulling bits out of the bitplanes. WriteVRAM
+    // re-decodes the one row a write touches. Only kept while there is a
+    // framebuffer to draw into.
+    struct TileCache
+    {
+        uint8_t rows[384][8][8];
+        uint8_t flipped[384][8][8];
+    };
+    std::unique_ptr<TileCache> tileCache;
+    const PixelKernels::Kernels* kernels = &PixelKernels::Best();
+    void DecodeTileRow(uint16_t tile, int row);
+    void DecodeAllTiles();
+
+    // Unchanged frames. contentGeneration moves on whenever VRAM, OAM or a
+    // display register changes value. A frame drawn at one generation
+    // throughout comes out the same while the generation holds, so the
+    // next frame's lines are skipped and the front buffer is kept at
+    // VBlank. A change partway through brings the skipped lines over from
+    // the front buffer and draws the rest.
+    uint32_t contentGeneration = 0;
+    uint32_t frontGeneration = 0;  // generation the front buffer was drawn at
+    bool frontReusable = false;    // front buffer drawn at frontGeneration throughout
+    uint32_t drawGeneration = 0;   // generation of the frame being drawn
+    bool drawStable = false;       // every line so far drawn at drawGeneration
+    bool skippingFrame = false;    // lines so far left as in the front buffer
+    uint32_t frameSerial = 0;
+    uint32_t unchangedFrames = 0;
+    void SetDisplayRegister(uint8_t& reg, uint8_t value)
+    {
+        if (reg != value) {
+            reg = value;
+            contentGeneration++;
+        }
+    }
+    void InvalidateFrame();
+    void SkipLine();
 
     // Helpers
-    void RenderBackground();
-    void RenderTileLine(int tileX, int tileY, int line);
-    void RenderSprites();
-    void RenderSprite(int index);
-
-    // Internal helper, not exposed publicly
-    inline uint8_t GetTilePixel(const uint8_t* tileData, int x, int y);
-    inline uint8_t MapShade(uint8_t paletteReg, uint8_t colorIndex) const { return (paletteReg >> (colorIndex * 2)) & 0x03; }
+    void ClearMemory();
+    void RenderLine();
+    void RenderBackgroundLine(uint8_t* colors);
+    void RenderWindowLine(uint8_t* colors);
+    void RenderSpritesLine(uint32_t* pixels, const uint8_t* colors);
+
+    uint16_t BGTileIndex(uint8_t mapEntry) const;
 };
@@ -0,0 +1,198 @@
+#include "PixelKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define GBEMU_PIXEL_X86 1
+#endif
+
+#ifdef GBEMU_PIXEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles any intrinsic; GCC and Clang only inside functions built
+// for the instruction set
+#if defined(GBEMU_PIXEL_X86) && defined(__GNUC__)
+#define GBEMU_TARGET(isa) __attribute__((target(isa)))
+#else
+#define GBEMU_TARGET(isa)
+#endif
+
+namespace PixelKernels
+{
+namespace
+{
+    // --- Scalar ---
+    void DecodeRowScalar(uint8_t low, uint8_t high, uint8_t* row, uint8_t* flipped)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            const uint8_t colorIndex = ((low >> (7 - x)) & 1) | (((high >> (7 - x)) & 1) << 1);
+            row[x] = colorIndex;
+            flipped[7 - x] = colorIndex;
+        }
+    }
+
+    void MapColorsScalar(const uint8_t* indices, const uint32_t lut[4], uint32_t* pixels, int count)
+    {
+        for (int x = 0; x < count; x++)
+            pixels[x] = lut[indices[x]];
+    }
+
+#ifdef GBEMU_PIXEL_X86
+    // --- SSE2 ---
+    // Both bitplanes broadcast and tested against one bit per byte: the low
+    // 8 bytes test bits 7..0 (the row), the high 8 bytes bits 0..7 (mirrored)
+    GBEMU_TARGET("sse2")
+    void DecodeRowSSE2(uint8_t low, uint8_t high, uint8_t* row, uint8_t* flipped)
+    {
+        const __m128i bits = _mm_setr_epi8(
+            char(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+            0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80));
+        const __m128i lowSet = _mm_cmpeq_epi8(_mm_and_si128(_mm_set1_epi8(char(low)), bits), bits);
+        const __m128i highSet = _mm_cmpeq_epi8(_mm_and_si128(_mm_set1_epi8(char(high)), bits), bits);
+        const __m128i indices = _mm_or_si128(_mm_and_si128(lowSet, _mm_set1_epi8(1)),
+                                             _mm_and_si128(highSet, _mm_set1_epi8(2)));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row), indices);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(flipped), _mm_unpackhi_epi64(indices, indices));
+    }
+
+    // --- SSSE3 ---
+    // The four colors are the 16 bytes of one register; PSHUFB picks byte
+    // 4 * index + b for byte b of each pixel, 4 pixels per store
+    GBEMU_TARGET("ssse3")
+    void MapColorsSSSE3(const uint8_t* indices, const uint32_t lut[4], uint32_t* pixels, int count)
+    {
+        const __m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lut));
+        const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+        const __m128i byteInPixel = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+
+        int x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + x));
+            // Indices are 0-3, so a 16-bit shift cannot carry between bytes
+            idx = _mm_slli_epi16(idx, 2);
+            __m128i* out = reinterpret_cast<__m128i*>(pixels + x);
+            for (int store = 0; store < 4; store++)
+            {
+                const __m128i select = _mm_add_epi8(_mm_shuffle_epi8(idx, spread), byteInPixel);
+                _mm_storeu_si128(out + store, _mm_shuffle_epi8(colors, select));
+                idx = _mm_srli_si128(idx, 4);
+            }
+        }
+        MapColorsScalar(indices + x, lut, pixels + x, count - x);
+    }
+
+    // --- AVX2 ---
+    // Eight indices widened to 32 bits select from the colors with one
+    // VPERMD, 8 pixels per store
+    GBEMU_TARGET("avx2")
+    void MapColorsAVX2(const uint8_t* indices, const uint32_t lut[4], uint32_t* pixels, int count)
+    {
+        const __m256i colors = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lut)));
+
+        int x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            const __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices + x)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + x), _mm256_permutevar8x32_epi32(colors, idx));
+        }
+        MapColorsScalar(indices + x, lut, pixels + x, count - x);
+    }
+
+    void Cpuid(unsigned int leaf, unsigned int regs[4])
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuidex(info, static_cast<int>(leaf), 0);
+        for (int i = 0; i < 4; i++)
+            regs[i] = static_cast<unsigned int>(info[i]);
+#else
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+        __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // The OS has to save the YMM registers too (OSXSAVE, then XCR0 bits 1-2)
+    bool OsSavesYmm(unsigned int ecx1)
+    {
+        if (!(ecx1 & (1u << 27)))
+            return false;
+#ifdef _MSC_VER
+        const unsigned long long xcr0 = _xgetbv(0);
+#else
+        unsigned int lo = 0, hi = 0;
+        __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        const unsigned long long xcr0 = (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+        return (xcr0 & 0x6) == 0x6;
+    }
+
+    // CPUID leaf 1: SSE2 is EDX bit 26, SSSE3 ECX bit 9, AVX ECX bit 28;
+    // leaf 7: AVX2 is EBX bit 5
+    bool HostSupports(Level level)
+    {
+        unsigned int leaf0[4], leaf1[4];
+        Cpuid(0, leaf0);
+        Cpuid(1, leaf1);
+        const bool sse2 = (leaf1[3] & (1u << 26)) != 0;
+        const bool ssse3 = sse2 && (leaf1[2] & (1u << 9)) != 0;
+        switch (level)
+        {
+        case Level::Scalar: return true;
+        case Level::SSE2: return sse2;
+        case Level::SSSE3: return ssse3;
+        case Level::AVX2:
+        {
+            if (!ssse3 || leaf0[0] < 7 || !(leaf1[2] & (1u << 28)) || !OsSavesYmm(leaf1[2]))
+                return false;
+            unsigned int leaf7[4];
+            Cpuid(7, leaf7);
+            return (leaf7[1] & (1u << 5)) != 0;
+        }
+        default: return false;
+        }
+    }
+#else
+    bool HostSupports(Level level) { return level == Level::Scalar; }
+#endif
+
+    const Kernels kScalar = { Level::Scalar, "scalar", &DecodeRowScalar, &MapColorsScalar };
+#ifdef GBEMU_PIXEL_X86
+    const Kernels kSSE2 = { Level::SSE2, "SSE2", &DecodeRowSSE2, &MapColorsScalar };
+    const Kernels kSSSE3 = { Level::SSSE3, "SSSE3", &DecodeRowSSE2, &MapColorsSSSE3 };
+    const Kernels kAVX2 = { Level::AVX2, "AVX2", &DecodeRowSSE2, &MapColorsAVX2 };
+#endif
+}
+
+const Kernels* Get(Level level)
+{
+    if (!HostSupports(level))
+        return nullptr;
+    switch (level)
+    {
+#ifdef GBEMU_PIXEL_X86
+    case Level::SSE2: return &kSSE2;
+    case Level::SSSE3: return &kSSSE3;
+    case Level::AVX2: return &kAVX2;
+#endif
+    case Level::Scalar: return &kScalar;
+    default: return nullptr;
+    }
+}
+
+const Kernels& Best()
+{
+    static const Kernels& best = [] () -> const Kernels& {
+        for (int level = static_cast<int>(Level::Count) - 1; level > 0; level--)
+            if (const Kernels* kernels = Get(static_cast<Level>(level)))
+                return *kernels;
+        return kScalar;
+    }();
+    return best;
+}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+
+// Inner loops of the PPU's line renderer. Each has a scalar version, which
+// is the reference, and SIMD versions for x86 hosts; Best() picks the
+// fastest the host supports once, at startup.
+namespace PixelKernels
+{
+    enum class Level : uint8_t
+    {
+        Scalar,
+        SSE2,  // tile row decode
+        SSSE3, // + palette lookup with PSHUFB, 4 pixels per store
+        AVX2,  // + palette lookup with VPERMD, 8 pixels per store
+        Count
+    };
+
+    // One 2bpp tile row to 8 color indices (pixel x is bit 7-x of low, plus
+    // bit 7-x of high as bit 1), and the same row mirrored
+    using DecodeRowFn = void (*)(uint8_t low, uint8_t high, uint8_t* row, uint8_t* flipped);
+
+    // count color indices (0-3) looked up in lut, written out as 32-bit pixels
+    using MapColorsFn = void (*)(const uint8_t* indices, const uint32_t lut[4], uint32_t* pixels, int count);
+
+    struct Kernels
+    {
+        Level level;
+        const char* name;
+        DecodeRowFn decodeRow;
+        MapColorsFn mapColors;
+    };
+
+    const Kernels& Best();
+
+    // The kernels of one level, nullptr when the host cannot run them
+    // (benchmarks and cross-checks)
+    const Kernels* Get(Level level);
+}
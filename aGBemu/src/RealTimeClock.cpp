@@ -0,0 +1,116 @@
+#include "RealTimeClock.h"
+#include <cstring>
+#include <ctime>
+
+namespace
+{
+    constexpr uint64_t kSecondsPerDay = 86400;
+    constexpr uint64_t kDayCounterRange = 512 * kSecondsPerDay; // 9-bit day counter
+    constexpr char kStateMagic[4] = { 'G', 'B', 'R', 'T' };
+    constexpr uint32_t kStateVersion = 1;
+}
+
+void RealTimeClock::Reset(uint64_t now)
+{
+    baseSeconds = 0;
+    baseCycle = now;
+    halted = carry = false;
+    std::memset(latched, 0, sizeof(latched));
+}
+
+// Move the whole seconds elapsed since baseCycle into baseSeconds, keeping
+// the fraction of the current second in baseCycle
+void RealTimeClock::Fold(uint64_t now)
+{
+    if (halted)
+    {
+        baseCycle = now;
+        return;
+    }
+    const uint64_t elapsed = (now - baseCycle) / kCyclesPerSecond;
+    baseSeconds += elapsed;
+    baseCycle += elapsed * kCyclesPerSecond;
+    Normalize();
+}
+
+void RealTimeClock::Normalize()
+{
+    if (baseSeconds >= kDayCounterRange)
+    {
+        carry = true;
+        baseSeconds %= kDayCounterRange;
+    }
+}
+
+void RealTimeClock::Latch(uint64_t now)
+{
+    Fold(now);
+    const uint64_t days = baseSeconds / kSecondsPerDay;
+    latched[SECONDS] = static_cast<uint8_t>(baseSeconds % 60);
+    latched[MINUTES] = static_cast<uint8_t>(baseSeconds / 60 % 60);
+    latched[HOURS] = static_cast<uint8_t>(baseSeconds / 3600 % 24);
+    latched[DAY_LOW] = static_cast<uint8_t>(days);
+    latched[DAY_HIGH] = static_cast<uint8_t>((days >> 8) | (halted ? 0x40 : 0) | (carry ? 0x80 : 0));
+}
+
+void RealTimeClock::Write(uint64_t now, int reg, uint8_t value)
+{
+    Fold(now);
+    uint64_t seconds = baseSeconds % 60;
+    uint64_t minutes = baseSeconds / 60 % 60;
+    uint64_t hours = baseSeconds / 3600 % 24;
+    uint64_t days = baseSeconds / kSecondsPerDay;
+
+    switch (reg)
+    {
+    case SECONDS:
+        seconds = value & 0x3F;
+        baseCycle = now; // writing the seconds restarts the current second
+        break;
+    case MINUTES: minutes = value & 0x3F; break;
+    case HOURS: hours = value & 0x1F; break;
+    case DAY_LOW: days = (days & 0x100) | value; break;
+    case DAY_HIGH:
+        days = (days & 0xFF) | ((value & 0x01) << 8);
+        carry = value & 0x80;
+        if (halted && !(value & 0x40))
+            baseCycle = now; // restarting; time stood still while halted
+        halted = value & 0x40;
+        break;
+    }
+    // Out-of-range values are not modelled exactly: 63 seconds is simply 1:03
+    baseSeconds = seconds + minutes * 60 + hours * 3600 + days * kSecondsPerDay;
+    Normalize();
+}
+
+RealTimeClock::State RealTimeClock::Save(uint64_t now)
+{
+    Fold(now);
+    State state = {};
+    std::memcpy(state.magic, kStateMagic, sizeof(kStateMagic));
+    state.version = kStateVersion;
+    state.savedAt = static_cast<int64_t>(std::time(nullptr));
+    state.seconds = baseSeconds;
+    state.halted = halted;
+    state.carry = carry;
+    std::memcpy(state.latched, latched, sizeof(latched));
+    return state;
+}
+
+bool RealTimeClock::Load(const State& state, uint64_t now)
+{
+    if (std::memcmp(state.magic, kStateMagic, sizeof(kStateMagic)) != 0 || state.version != kStateVersion)
+        return false;
+    baseSeconds = state.seconds;
+    baseCycle = now;
+    halted = state.halted;
+    carry = state.carry;
+    std::memcpy(latched, state.latched, sizeof(latched));
+
+    // The cartridge's clock kept running while the emulator was closed
+    const int64_t away = static_cast<int64_t>(std::time(nullptr)) - state.savedAt;
+    if (!halted && away > 0)
+        baseSeconds += static_cast<uint64_t>(away);
+    Normalize();
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+
+// MBC3 real-time clock. Nothing ticks: the clock is a count of seconds at a
+// base point in emulated time, and the S/M/H/DL/DH registers are worked out
+// from the cycles elapsed since then when the game latches or writes them.
+// Running on emulated cycles means fast-forward runs the clock fast too;
+// between sessions it catches up on the wall-clock time that passed.
+class RealTimeClock
+{
+public:
+    static constexpr uint64_t kCyclesPerSecond = 4194304;
+
+    enum Register { SECONDS, MINUTES, HOURS, DAY_LOW, DAY_HIGH };
+
+    // Day 0, 00:00:00, running
+    void Reset(uint64_t now);
+
+    // Copy the current time into the readable registers
+    void Latch(uint64_t now);
+    uint8_t Read(int reg) const { return latched[reg]; }
+    void Write(uint64_t now, int reg, uint8_t value);
+
+    // The emulated clock is about to be reset; keep the time across it
+    void Suspend(uint64_t now) { Fold(now); }
+    void Resume(uint64_t now) { baseCycle = now; }
+
+    // On-disk form, stored next to the .sav (little-endian)
+    struct State
+    {
+        char magic[4];
+        uint32_t version;
+        int64_t savedAt;  // wall-clock time of the save, Unix seconds
+        uint64_t seconds; // clock value, days wrapped to 0-511
+        uint8_t halted;
+        uint8_t carry;
+        uint8_t latched[5];
+    };
+    State Save(uint64_t now);
+    // False if the state is not a saved clock; otherwise restored and
+    // advanced by the wall-clock time since it was saved
+    bool Load(const State& state, uint64_t now);
+
+private:
+    uint64_t baseSeconds = 0; // clock value at baseCycle
+    uint64_t baseCycle = 0;
+    bool halted = false;      // DH bit 6
+    bool carry = false;       // DH bit 7, day counter overflowed
+    uint8_t latched[5] = {};
+
+    void Fold(uint64_t now);
+    void Normalize();
+};
@@ -0,0 +1,195 @@
+#include "RenderBenchmark.h"
+#include "MMU.h"
+#include "PPU.h"
+#include "PixelKernels.h"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+
+namespace
+{
+    constexpr uint32_t kCyclesPerFrame = 70224; // 154 lines of 456 cycles
+
+    enum class Scene { Scrolling, Static, Headless };
+
+    double MicrosecondsPerFrame(uint32_t frames, Scene scene)
+    {
+        const bool framebuffer = scene != Scene::Headless;
+        auto ppu = std::make_unique<PPU>();
+        ppu->SetFramebufferEnabled(framebuffer);
+        auto mmu = std::make_unique<MMU>(ppu.get());
+
+        // The power-on test pattern fills the tiles and the map; add the
+        // window over the bottom half and four full rows of sprites
+        mmu->Write8(0xFF40, 0xF3); // LCD, window at 9C00, BG, 8x8 sprites
+        mmu->Write8(0xFF4A, 72);
+        mmu->Write8(0xFF4B, 47);
+        mmu->Write8(0xFF43, 3);
+        for (uint16_t i = 0; i < 40; i++)
+        {
+            mmu->Write8(static_cast<uint16_t>(0xFE00 + i * 4 + 0), static_cast<uint8_t>(16 + (i / 10) * 36));
+            mmu->Write8(static_cast<uint16_t>(0xFE00 + i * 4 + 1), static_cast<uint8_t>(8 + (i % 10) * 15));
+            mmu->Write8(static_cast<uint16_t>(0xFE00 + i * 4 + 2), static_cast<uint8_t>(i));
+            mmu->Write8(static_cast<uint16_t>(0xFE00 + i * 4 + 3), static_cast<uint8_t>((i & 1) ? 0x20 : 0x00));
+        }
+
+        Scheduler& scheduler = mmu->GetScheduler();
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            // A new SCX each frame keeps the unchanged-frame check from
+            // skipping the drawing
+            if (scene == Scene::Scrolling)
+                mmu->Write8(0xFF43, static_cast<uint8_t>(i));
+            scheduler.Advance(kCyclesPerFrame);
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::micro>(elapsed).count() / frames;
+    }
+
+    // All 65536 tile rows, then random lines of every length up to 160 with
+    // a guard byte past the end
+    bool MatchesScalar(const PixelKernels::Kernels& kernels, const PixelKernels::Kernels& scalar)
+    {
+        for (int bits = 0; bits < 0x10000; bits++)
+        {
+            uint8_t row[8], flipped[8], expectedRow[8], expectedFlipped[8];
+            kernels.decodeRow(static_cast<uint8_t>(bits), static_cast<uint8_t>(bits >> 8), row, flipped);
+            scalar.decodeRow(static_cast<uint8_t>(bits), static_cast<uint8_t>(bits >> 8), expectedRow, expectedFlipped);
+            if (std::memcmp(row, expectedRow, 8) != 0 || std::memcmp(flipped, expectedFlipped, 8) != 0)
+                return false;
+        }
+
+        std::mt19937 rng(1);
+        for (int count = 0; count <= 160; count++)
+        {
+            uint8_t indices[160];
+            uint32_t lut[4];
+            for (uint8_t& index : indices)
+                index = static_cast<uint8_t>(rng() & 3);
+            for (uint32_t& color : lut)
+                color = static_cast<uint32_t>(rng());
+            uint32_t pixels[161], expected[161];
+            std::memset(pixels, 0xA5, sizeof(pixels));
+            std::memset(expected, 0xA5, sizeof(expected));
+            kernels.mapColors(indices, lut, pixels, count);
+            scalar.mapColors(indices, lut, expected, count);
+            if (std::memcmp(pixels, expected, sizeof(pixels)) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    template<typename Body>
+    double NanosecondsPerCall(uint32_t calls, Body body)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        body();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / calls;
+    }
+}
+
+RenderBenchmarkResult RunRenderBenchmark(uint32_t frames)
+{
+    RenderBenchmarkResult result;
+    result.render = MicrosecondsPerFrame(frames, Scene::Scrolling);
+    result.unchanged = MicrosecondsPerFrame(frames, Scene::Static);
+    result.timeline = MicrosecondsPerFrame(frames, Scene::Headless);
+    return result;
+}
+
+std::vector<PixelKernelResult> RunPixelKernelBenchmark(uint32_t iterations)
+{
+    const PixelKernels::Kernels& scalar = *PixelKernels::Get(PixelKernels::Level::Scalar);
+    std::vector<PixelKernelResult> results;
+
+    uint8_t indices[160];
+    for (int x = 0; x < 160; x++)
+        indices[x] = static_cast<uint8_t>((x * 7 + x / 3) & 3);
+    const uint32_t lut[4] = { 0xFFFFFFFF, 0xFFC0C0C0, 0xFF606060, 0xFF000000 };
+
+    for (int level = 0; level < static_cast<int>(PixelKernels::Level::Count); level++)
+    {
+        const PixelKernels::Kernels* kernels = PixelKernels::Get(static_cast<PixelKernels::Level>(level));
+        if (!kernels)
+            continue;
+        PixelKernelResult result;
+        result.name = kernels->name;
+        result.matchesScalar = MatchesScalar(*kernels, scalar);
+
+        // Rows go to a tile cache sized buffer so the stores are not
+        // optimised away
+        static uint8_t rows[384][8][8], flipped[384][8][8];
+        result.decodeRow = NanosecondsPerCall(iterations, [&] {
+            for (uint32_t i = 0; i < iterations; i++)
+                kernels->decodeRow(static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8),
+                                   rows[i % 384][(i >> 3) & 7], flipped[i % 384][(i >> 3) & 7]);
+        });
+
+        static uint32_t pixels[144][160];
+        const uint32_t lines = iterations / 16;
+        result.mapLine = NanosecondsPerCall(lines, [&] {
+            for (uint32_t i = 0; i < lines; i++)
+                kernels->mapColors(indices, lut, pixels[i % 144], 160);
+        });
+        results.push_back(result);
+    }
+    return results;
+}
+
+namespace
+{
+    // A scratch PPU/MMU pair on the power-on test pattern with the given
+    // background palette, run frame by frame from time 0
+    struct ScratchPPU
+    {
+        std::unique_ptr<PPU> ppu = std::make_unique<PPU>();
+        std::unique_ptr<MMU> mmu = std::make_unique<MMU>(ppu.get());
+
+        explicit ScratchPPU(uint8_t bgp) { mmu->Write8(0xFF47, bgp); }
+        void Run(uint32_t cycles) { mmu->GetScheduler().Advance(cycles); }
+        bool FrameEquals(const ScratchPPU& other) const
+        {
+            return std::memcmp(ppu->GetFramebuffer(), other.ppu->GetFramebuffer(), 160 * 144 * sizeof(uint32_t)) == 0;
+        }
+    };
+}
+
+bool CheckUnchangedFrames()
+{
+    constexpr uint32_t kCyclesPerLine = 456;
+
+    // Framebuffer off for a while, back on at line 60: the half-drawn frame
+    // that follows must not be reused as if it were complete
+    {
+        ScratchPPU ppu(0xFF), reference(0xFF);
+        ppu.Run(5 * kCyclesPerFrame);
+        ppu.ppu->SetFramebufferEnabled(false);
+        ppu.Run(60 * kCyclesPerLine + 100);
+        ppu.ppu->SetFramebufferEnabled(true);
+        ppu.Run(10 * kCyclesPerFrame - (60 * kCyclesPerLine + 100));
+        reference.Run(15 * kCyclesPerFrame);
+        if (!ppu.FrameEquals(reference))
+            return false;
+    }
+
+    // SCX changes at line 72 after a run of skipped frames: the skipped top
+    // half comes over from the front buffer, the rest is drawn scrolled
+    {
+        ScratchPPU ppu(0xE4), reference(0xE4);
+        ppu.Run(5 * kCyclesPerFrame + 72 * kCyclesPerLine);
+        ppu.mmu->Write8(0xFF43, 5);
+        ppu.Run(kCyclesPerFrame - 72 * kCyclesPerLine);
+        reference.ppu->SetFramebufferEnabled(false);
+        reference.Run(5 * kCyclesPerFrame);
+        reference.ppu->SetFramebufferEnabled(true);
+        reference.Run(72 * kCyclesPerLine);
+        reference.mmu->Write8(0xFF43, 5);
+        reference.Run(kCyclesPerFrame - 72 * kCyclesPerLine);
+        if (ppu.ppu->GetUnchangedFrameCount() == 0 || !ppu.FrameEquals(reference))
+            return false;
+    }
+    return true;
+}
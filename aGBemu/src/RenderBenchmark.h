@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Dev-only microbenchmark of the PPU: runs whole frames on a private PPU/MMU
+// pair with no CPU, so nothing but the mode timeline and line rendering is
+// timed. The scene has the background, the window and four bands of ten
+// sprites (half of them X-flipped) on screen.
+struct RenderBenchmarkResult
+{
+    // Microseconds per frame
+    double render = 0;    // scrolling every frame: timeline plus drawing
+    double unchanged = 0; // the same picture every frame, so nothing is drawn
+    double timeline = 0;  // framebuffer off: LY/STAT and interrupts only
+};
+
+RenderBenchmarkResult RunRenderBenchmark(uint32_t frames = 2000);
+
+// Each PixelKernels level the host supports, scalar first, checked against
+// the scalar kernels and timed on its own
+struct PixelKernelResult
+{
+    const char* name = "";
+    bool matchesScalar = false; // every tile row and a range of line lengths
+    double decodeRow = 0;       // nanoseconds per tile row
+    double mapLine = 0;         // nanoseconds per 160-pixel line
+};
+
+std::vector<PixelKernelResult> RunPixelKernelBenchmark(uint32_t iterations = 1u << 20);
+
+// Unchanged-frame detection against frames drawn in full: the framebuffer
+// switched back on partway through a frame, and a register changed
+// partway through a run of skipped frames. True when every frame matches.
+bool CheckUnchangedFrames();
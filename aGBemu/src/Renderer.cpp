@@ -1,11 +1,18 @@
 #include "Renderer.h"
-#include "CPU.h"
+#include "Emulator.h"
+#include "Jit.h"
 #include <imgui.h>
 #include <backends/imgui_impl_sdl3.h>
 #include <backends/imgui_impl_opengl3.h>
 #include <SDL3/SDL_log.h>
 #include <SDL3/SDL_dialog.h>
-#include "MMU.h"
+#include "FrameBenchmark.h"
+#include "MemoryBenchmark.h"
+#include "RenderBenchmark.h"
+#include "ExecutionCheck.h"
+#include "AluBenchmark.h"
+#include "InterruptCheck.h"
+#include "OpcodeBenchmark.h"
 
 // Simple vertex & fragment shaders for fullscreen quad
 static const char* vertexShaderSrc = R"(
@@ -78,8 +85,9 @@ void Renderer::InitFramebufferTexture()
     glBindTexture(GL_TEXTURE_2D, gbTexture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 160, 144, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 160, 144, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
     glBindTexture(GL_TEXTURE_2D, 0);
+    textureValid = false;
 }
 
 void Renderer::InitFullscreenQuad()
@@ -178,32 +186,34 @@ void Renderer::BeginFrame()
 static void SDLCALL OnRomSelected(void* userdata, const char* const* filelist, int numfiles)
 {
     if (!userdata || numfiles <= 0 || !filelist || !filelist[0]) return;
-    MMU* mmu = reinterpret_cast<MMU*>(userdata);
+    Emulator* emulator = reinterpret_cast<Emulator*>(userdata);
     const char* path = filelist[0];
-    if (!mmu->LoadROMFromFile(path)) {
+    if (!emulator->LoadRom(path)) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load ROM: %s", path);
     } else {
         SDL_Log("Loaded ROM: %s", path);
     }
 }
 
-void Renderer::RenderUI(PPU* ppu, CPU* cpu, MMU* mmu, bool* paused)
+void Renderer::RenderUI(Emulator* emulator, bool* paused)
 {
+    CPU* cpu = emulator ? &emulator->GetCPU() : nullptr;
+
     ImGui::Begin("GameBoy Emulator");
 
     ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
 
     // ROM controls
-    if (mmu)
+    if (emulator)
     {
         if (ImGui::Button("Open ROM..."))
         {
-            SDL_ShowOpenFileDialog(OnRomSelected, mmu, window, nullptr, 0, nullptr, false);
+            SDL_ShowOpenFileDialog(OnRomSelected, emulator, window, nullptr, 0, nullptr, false);
         }
         ImGui::SameLine();
         ImGui::TextDisabled("Drag & drop a .gb file onto the window");
 
-        bool loaded = mmu->IsROMLoaded();
+        bool loaded = emulator->IsRomLoaded();
         ImGui::Text("ROM: %s", loaded ? "Loaded" : "None");
     }
 
@@ -217,16 +227,128 @@ void Renderer::RenderUI(PPU* ppu, CPU* cpu, MMU* mmu, bool* paused)
         }
     }
 
-    // Show only registers A and B from CPU
+    // Developer options: execution modes and the benchmarks and checks. The
+    // buttons run on this thread and stall the UI until they finish, so the
+    // section starts collapsed
+    if (cpu && ImGui::CollapsingHeader("Developer")) {
+        // Interpreter vs pre-decoded block execution
+        bool blockCache = cpu->IsBlockCacheEnabled();
+        if (ImGui::Checkbox("Block cache", &blockCache))
+        {
+            cpu->SetBlockCacheEnabled(blockCache);
+        }
+        if (Jit::IsSupported())
+        {
+            bool jit = cpu->IsJitEnabled();
+            if (ImGui::Checkbox("JIT (x86-64)", &jit))
+            {
+                cpu->SetJitEnabled(jit);
+            }
+        }
+
+        // Off for accuracy testing; the count restarts with each ROM
+        bool idleSkip = cpu->IsIdleLoopSkipEnabled();
+        if (ImGui::Checkbox("Idle-loop skip", &idleSkip))
+        {
+            cpu->SetIdleLoopSkipEnabled(idleSkip);
+        }
+        if (idleSkip)
+        {
+            ImGui::SameLine();
+            ImGui::TextDisabled("%llu cycles skipped", static_cast<unsigned long long>(cpu->GetIdleSkippedCycles()));
+        }
+
+        // Time MMU accesses on a scratch memory map
+        if (ImGui::Button("Memory benchmark"))
+        {
+            const MemoryBenchmarkResult r = RunMemoryBenchmark();
+            SDL_Log("Memory benchmark (ns/access): ROM read %.2f, WRAM read %.2f, WRAM write %.2f, "
+                    "VRAM write %.2f, HRAM read %.2f, IO read %.2f, IO write %.2f, mixed %.2f",
+                    r.romRead, r.wramRead, r.wramWrite, r.vramWrite, r.hramRead, r.ioRead, r.ioWrite, r.mixed);
+        }
+
+        // RunFrame speed on a scratch core running the loaded ROM
+        ImGui::SameLine();
+        if (ImGui::Button("Frame benchmark"))
+        {
+            const FrameBenchmarkResult r = RunFrameBenchmark(emulator->GetRomPath());
+            SDL_Log("Frame benchmark (frames/s): interpreter %.0f, block cache %.0f, JIT %.0f",
+                    r.interpreter, r.blockCache, r.jit);
+        }
+
+        // PPU frame cost on a scratch core, no CPU
+        ImGui::SameLine();
+        if (ImGui::Button("Render benchmark"))
+        {
+            const RenderBenchmarkResult r = RunRenderBenchmark();
+            SDL_Log("Render benchmark (us/frame): render %.1f, unchanged %.1f, timeline only %.1f",
+                    r.render, r.unchanged, r.timeline);
+            for (const PixelKernelResult& k : RunPixelKernelBenchmark())
+                SDL_Log("  %s kernels: %s scalar, tile row decode %.2f ns, 160-pixel line %.1f ns",
+                        k.name, k.matchesScalar ? "match" : "DO NOT MATCH", k.decodeRow, k.mapLine);
+            SDL_Log("  unchanged-frame check: %s", CheckUnchangedFrames() ? "passed" : "FAILED");
+        }
+
+        // Block cache and JIT in lockstep with the interpreter
+        if (ImGui::Button("Execution check"))
+        {
+            const ExecutionCheckResult r = RunExecutionCheck();
+            SDL_Log("Execution check (%u generated programs): block cache %s, JIT %s", r.programs,
+                    r.blockCache.empty() ? "matches" : r.blockCache.c_str(),
+                    !Jit::IsSupported() ? "unsupported" : r.jit.empty() ? "matches" : r.jit.c_str());
+        }
+
+        // Flag-heavy generated code on a scratch core, plus lazy vs eager flags
+        ImGui::SameLine();
+        if (ImGui::Button("ALU benchmark"))
+        {
+            const AluBenchmarkResult r = RunAluBenchmark();
+            SDL_Log("ALU benchmark (emulated MHz): interpreter %.1f, block cache %.1f, JIT %.1f",
+                    r.interpreter, r.blockCache, r.jit);
+            SDL_Log("  lazy vs eager flags check: %s", CheckLazyFlags() ? "passed" : "FAILED");
+        }
+
+        // EI delay, HALT wake and dispatch timing on scratch cores
+        ImGui::SameLine();
+        if (ImGui::Button("Interrupt check"))
+        {
+            const std::vector<std::string> failures = RunInterruptCheck();
+            SDL_Log("Interrupt check: %s", failures.empty() ? "passed" : "FAILED");
+            for (const std::string& failure : failures)
+                SDL_Log("  %s", failure.c_str());
+        }
+
+        // Register-only instructions on a scratch core, dispatch cost
+        if (ImGui::Button("Opcode benchmark"))
+        {
+            const OpcodeBenchmarkResult r = RunOpcodeBenchmark();
+            SDL_Log("Opcode benchmark (M instructions/s): Step loop %.1f, interpreter %.1f, block cache %.1f, JIT %.1f",
+                    r.step, r.interpreter, r.blockCache, r.jit);
+            const OpcodeBenchmarkResult cb = RunCBOpcodeBenchmark();
+            SDL_Log("  CB page: Step loop %.1f, interpreter %.1f, block cache %.1f, JIT %.1f",
+                    cb.step, cb.interpreter, cb.blockCache, cb.jit);
+            const std::string mismatch = CheckCBOpcodes();
+            SDL_Log("  CB reference check: %s", mismatch.empty() ? "passed" : mismatch.c_str());
+        }
+    }
+
+    // Register snapshot
     if (cpu) {
-        ImGui::Text("Registers (Test Program):");
-        ImGui::Text("A: 0x%02X", cpu->GetA());
-        ImGui::Text("B: 0x%02X", cpu->GetB());
+        const CPU::Registers r = cpu->GetRegisters();
+        ImGui::Text("Registers:");
+        ImGui::Text("AF: 0x%04X  BC: 0x%04X", r.AF, r.BC);
+        ImGui::Text("DE: 0x%04X  HL: 0x%04X", r.DE, r.HL);
+        ImGui::Text("SP: 0x%04X  PC: 0x%04X", r.SP, r.PC);
+        ImGui::Text("Flags: %c%c%c%c",
+            (r.F & 0x80) ? 'Z' : '-', (r.F & 0x40) ? 'N' : '-',
+            (r.F & 0x20) ? 'H' : '-', (r.F & 0x10) ? 'C' : '-');
     }
 
-    // Optional: PPU placeholder
-    if (ppu) {
-        ImGui::Text("PPU framebuffer placeholder");
+    // Unchanged frames: drawing skipped by the PPU, uploads skipped here
+    if (emulator) {
+        const PPU& ppu = emulator->GetPPU();
+        ImGui::Text("Frames: %u, unchanged %u", ppu.GetFrameCount(), ppu.GetUnchangedFrameCount());
+        ImGui::Text("Texture uploads skipped: %llu", static_cast<unsigned long long>(uploadsSkipped));
     }
 
     ImGui::End();
@@ -235,13 +357,19 @@ void Renderer::RenderUI(PPU* ppu, CPU* cpu, MMU* mmu, bool* paused)
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
-void Renderer::RenderGameboyFrame(uint8_t* ppuFramebuffer)
+void Renderer::RenderGameboyFrame(const uint32_t* ppuFramebuffer, uint32_t frameSerial)
 {
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, gbTexture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 160, 144, GL_RGB, GL_UNSIGNED_BYTE, ppuFramebuffer);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (textureValid && frameSerial == textureSerial) {
+        uploadsSkipped++;
+    } else {
+        // Packed pixels with R in the low byte; rows are 4-byte aligned, so
+        // the default unpack alignment holds
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 160, 144, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, ppuFramebuffer);
+        textureValid = true;
+        textureSerial = frameSerial;
+    }
 
     glUseProgram(shaderProgram);
     glBindVertexArray(quadVAO);
@@ -5,9 +5,7 @@
 #include <cstdint>
 
 // Forward declarations
-class PPU;
-class CPU;
-class MMU;
+class Emulator;
 
 class Renderer
 {
@@ -23,8 +21,10 @@ public:
 
     // Frame lifecycle
     void BeginFrame();
-    void RenderUI(PPU* ppu = nullptr, CPU* cpu = nullptr, MMU* mmu = nullptr, bool* paused = nullptr); // add ROM UI + pause toggle
-    void RenderGameboyFrame(uint8_t* ppuFramebuffer);
+    void RenderUI(Emulator* emulator = nullptr, bool* paused = nullptr); // add ROM UI + pause toggle
+    // frameSerial is PPU::GetFrameSerial(); a frame already on the texture
+    // is not uploaded again
+    void RenderGameboyFrame(const uint32_t* ppuFramebuffer, uint32_t frameSerial);
     void EndFrame();
 
     // Shutdown everything cleanly
@@ -35,6 +35,9 @@ private:
     SDL_Window* window;
 
     GLuint gbTexture;
+    bool textureValid = false;
+    uint32_t textureSerial = 0;
+    uint64_t uploadsSkipped = 0;
 
     // Fullscreen quad for scaling GameBoy framebuffer
     GLuint quadVAO = 0;
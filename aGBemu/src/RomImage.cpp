@@ -0,0 +1,243 @@
+#include "RomImage.h"
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using FileId = RomImage::FileId;
+
+    // Content hash -> live image, plus the files those images came from.
+    // Entries expire with their last owner and are swept on insertion.
+    std::mutex registryMutex;
+    std::unordered_map<uint64_t, std::weak_ptr<const RomImage>> byContent;
+    std::map<FileId, std::weak_ptr<const RomImage>> byFile;
+
+#ifdef _WIN32
+    using FileHandle = HANDLE;
+
+    bool OpenFile(const char* path, FileHandle& file, FileId& id)
+    {
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        BY_HANDLE_FILE_INFORMATION info;
+        if (!GetFileInformationByHandle(file, &info))
+        {
+            CloseHandle(file);
+            return false;
+        }
+        id.device = info.dwVolumeSerialNumber;
+        id.index = (uint64_t(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        id.size = (uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+        id.modified = (uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+        return true;
+    }
+
+    void CloseFile(FileHandle file) { CloseHandle(file); }
+
+    const uint8_t* MapFile(FileHandle file, size_t)
+    {
+        const void* view = nullptr;
+        if (HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr))
+        {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); // the view keeps the mapping alive
+        }
+        return static_cast<const uint8_t*>(view);
+    }
+
+    void UnmapFile(const uint8_t* data, size_t) { UnmapViewOfFile(data); }
+#else
+    using FileHandle = int;
+
+    bool OpenFile(const char* path, FileHandle& file, FileId& id)
+    {
+        file = open(path, O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat st;
+        if (fstat(file, &st) != 0)
+        {
+            close(file);
+            return false;
+        }
+        id.device = static_cast<uint64_t>(st.st_dev);
+        id.index = static_cast<uint64_t>(st.st_ino);
+        id.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+        const timespec& mtime = st.st_mtimespec;
+#else
+        const timespec& mtime = st.st_mtim;
+#endif
+        id.modified = uint64_t(mtime.tv_sec) * 1000000000u + uint64_t(mtime.tv_nsec);
+        return true;
+    }
+
+    void CloseFile(FileHandle file) { close(file); }
+
+    // Read-only: nothing can write through the mapping. MAP_PRIVATE does
+    // not isolate it from the file, though: pages never written here (all
+    // of them) show later writes to the file, and reading past the end of a
+    // truncated file raises SIGBUS. See the note on RomImage.
+    const uint8_t* MapFile(FileHandle file, size_t size)
+    {
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        return view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+    }
+
+    void UnmapFile(const uint8_t* data, size_t size) { munmap(const_cast<uint8_t*>(data), size); }
+#endif
+
+    template<typename Map>
+    void SweepExpired(Map& map)
+    {
+        for (auto e = map.begin(); e != map.end();)
+            e = e->second.expired() ? map.erase(e) : std::next(e);
+    }
+}
+
+RomImage::~RomImage()
+{
+    if (mapped)
+        UnmapFile(data, size);
+}
+
+std::shared_ptr<const RomImage> RomImage::Open(const char* path)
+{
+    FileHandle file;
+    FileId id;
+    if (!OpenFile(path, file, id))
+    {
+        std::cerr << "Failed to open ROM: " << path << std::endl;
+        return nullptr;
+    }
+    if (id.size == 0)
+    {
+        std::cerr << "ROM is empty: " << path << std::endl;
+        CloseFile(file);
+        return nullptr;
+    }
+
+    {
+        // The key is what the file is now, so a hit is an unchanged file
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto it = byFile.find(id);
+        if (it != byFile.end())
+            if (std::shared_ptr<const RomImage> existing = it->second.lock())
+            {
+                CloseFile(file);
+                return existing;
+            }
+    }
+
+    const uint8_t* data = MapFile(file, static_cast<size_t>(id.size));
+    CloseFile(file); // the mapping holds its own reference to the file
+    if (!data)
+    {
+        std::cerr << "Failed to map ROM: " << path << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<RomImage> image(new RomImage());
+    image->data = data;
+    image->size = static_cast<size_t>(id.size);
+    image->mapped = true;
+    image->path = path;
+    image->fileId = id;
+    image->hash = HashBytes(data, image->size);
+    std::shared_ptr<const RomImage> shared = Share(std::move(image));
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    SweepExpired(byFile);
+    byFile[id] = shared;
+    return shared;
+}
+
+std::shared_ptr<const RomImage> RomImage::FromBytes(std::vector<uint8_t> bytes)
+{
+    std::shared_ptr<RomImage> image(new RomImage());
+    image->owned = std::move(bytes);
+    image->data = image->owned.data();
+    image->size = image->owned.size();
+    image->hash = HashBytes(image->data, image->size);
+    return Share(std::move(image));
+}
+
+// Return the registered image with the same contents, or register this one
+std::shared_ptr<const RomImage> RomImage::Share(std::shared_ptr<RomImage> image)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto it = byContent.find(image->hash);
+    if (it != byContent.end())
+    {
+        std::shared_ptr<const RomImage> existing = it->second.lock();
+        // A mapping whose file has been written to no longer holds the
+        // contents it was hashed from: replace it with the new image
+        if (existing && !existing->IsFileUnchanged())
+            existing.reset();
+        if (existing && existing->size == image->size && std::memcmp(existing->data, image->data, image->size) == 0)
+            return existing; // the new copy/mapping is released with `image`
+        if (existing)
+            return image; // hash collision: keep it private rather than evict a live image
+    }
+
+    SweepExpired(byContent);
+    byContent[image->hash] = image;
+    return image;
+}
+
+bool RomImage::IsFileUnchanged() const
+{
+    if (!mapped)
+        return true;
+    FileHandle file;
+    FileId current;
+    if (!OpenFile(path.c_str(), file, current))
+        return false;
+    CloseFile(file);
+    return current == fileId;
+}
+
+size_t RomImage::GetSharedCount()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    size_t count = 0;
+    for (const auto& entry : byContent)
+        count += entry.second.expired() ? 0 : 1;
+    return count;
+}
+
+// 64-bit multiply/rotate hash over 8-byte words; only needs to be fast and
+// well spread, equality is confirmed with memcmp
+uint64_t RomImage::HashBytes(const uint8_t* bytes, size_t count)
+{
+    constexpr uint64_t kMul = 0x9E3779B97F4A7C15ull;
+    uint64_t h = count * kMul;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        h = ((h ^ word) * kMul);
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes + i, count - i);
+    h = (h ^ tail) * kMul;
+    return h ^ (h >> 32);
+}
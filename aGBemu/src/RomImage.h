@@ -0,0 +1,63 @@
+#pragma once
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// An immutable cartridge image. Files are mapped read-only rather than
+// copied, and every image is entered into a process-wide registry keyed by
+// a hash of its contents: opening a game that is already loaded somewhere
+// in the process (under any path) hands back the existing image, so any
+// number of emulator instances running the same ROM share one mapping.
+// Images are released when the last instance lets go of them.
+//
+// A mapping follows its file: ROM files must not be modified or truncated
+// while a game is running from them. A mapped image is only handed out
+// again while its file still has the identity (size, modification time) it
+// was mapped with.
+class RomImage
+{
+public:
+    // Map a file; nullptr on failure (reason printed to std::cerr)
+    static std::shared_ptr<const RomImage> Open(const char* path);
+
+    // Image built in memory (test programs, padded dumps)
+    static std::shared_ptr<const RomImage> FromBytes(std::vector<uint8_t> bytes);
+
+    ~RomImage();
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+    uint64_t Hash() const { return hash; }
+    bool IsMapped() const { return mapped; }
+
+    // Number of distinct images alive in the registry
+    static size_t GetSharedCount();
+
+    // Enough to tell whether a path still names the file an image was
+    // mapped from, so reopening it can skip mapping and hashing entirely
+    struct FileId
+    {
+        uint64_t device = 0, index = 0, size = 0, modified = 0;
+        auto operator<=>(const FileId&) const = default;
+    };
+
+private:
+    RomImage() = default;
+
+    static uint64_t HashBytes(const uint8_t* bytes, size_t count);
+    static std::shared_ptr<const RomImage> Share(std::shared_ptr<RomImage> image);
+    bool IsFileUnchanged() const; // true for images not mapped from a file
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint64_t hash = 0;
+    bool mapped = false;
+    std::vector<uint8_t> owned; // backing store when not mapped
+    std::string path;           // mapped images: the file, as it was when mapped
+    FileId fileId;
+};
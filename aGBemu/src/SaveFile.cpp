@@ -0,0 +1,340 @@
+#include "SaveFile.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct JournalHeader
+    {
+        char magic[4];
+        uint32_t count;
+        uint64_t checksum;
+    };
+    constexpr char kJournalMagic[4] = { 'G', 'B', 'S', 'J' };
+    constexpr uint32_t kMaxJournalPages = 0x20000 / SaveFile::kPageSize; // 128 KB, the largest cartridge RAM
+
+    // FNV-1a; only has to catch a journal that was cut short
+    uint64_t Checksum(const SaveFile::Page* pages, size_t count)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(pages);
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (size_t i = 0; i < count * sizeof(SaveFile::Page); i++)
+            h = (h ^ bytes[i]) * 0x100000001B3ull;
+        return h;
+    }
+
+    bool SyncFile(std::FILE* file)
+    {
+        if (std::fflush(file) != 0)
+            return false;
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // A newly created journal must survive a crash as well as its contents
+    void SyncParentDirectory(const std::string& path)
+    {
+#ifndef _WIN32
+        const size_t slash = path.find_last_of('/');
+        const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        const int fd = open(dir.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            fsync(fd);
+            close(fd);
+        }
+#else
+        (void)path; // NTFS journals its own metadata
+#endif
+    }
+
+    // Finish a batch that was journaled but maybe not fully applied
+    void ReplayJournal(const std::string& journalPath, const std::string& path)
+    {
+        std::FILE* journal = std::fopen(journalPath.c_str(), "rb");
+        if (!journal)
+            return;
+        JournalHeader header;
+        std::vector<SaveFile::Page> pages;
+        if (std::fread(&header, sizeof(header), 1, journal) == 1 &&
+            std::memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) == 0 && header.count <= kMaxJournalPages)
+        {
+            pages.resize(header.count);
+            if (std::fread(pages.data(), sizeof(SaveFile::Page), pages.size(), journal) != pages.size() ||
+                Checksum(pages.data(), pages.size()) != header.checksum)
+                pages.clear(); // torn journal: the .sav was never touched
+        }
+        std::fclose(journal);
+        if (pages.empty())
+            return;
+
+        std::FILE* file = std::fopen(path.c_str(), "r+b");
+        if (!file)
+            file = std::fopen(path.c_str(), "w+b");
+        if (!file)
+            return;
+        for (const SaveFile::Page& page : pages)
+        {
+            std::fseek(file, static_cast<long>(page.offset), SEEK_SET);
+            std::fwrite(page.data, 1, SaveFile::kPageSize, file);
+        }
+        SyncFile(file);
+        std::fclose(file);
+        std::cerr << "Recovered " << pages.size() << " unsaved page(s) of " << path << std::endl;
+    }
+
+    uint8_t* MapSave(const std::string& path, size_t size, void*& handle)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return nullptr;
+        void* view = nullptr;
+        // A mapping larger than the file grows it; a smaller one maps its start
+        const uint64_t size64 = size;
+        if (HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32),
+                                                static_cast<DWORD>(size64), nullptr))
+        {
+            view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+            CloseHandle(mapping);
+        }
+        if (!view)
+        {
+            CloseHandle(file);
+            return nullptr;
+        }
+        handle = file;
+        return static_cast<uint8_t*>(view);
+#else
+        (void)handle;
+        const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            return nullptr;
+        struct stat st;
+        void* view = MAP_FAILED;
+        // Never shrink: other emulators append clock data after the RAM
+        if (fstat(fd, &st) == 0 && (static_cast<size_t>(st.st_size) >= size || ftruncate(fd, size) == 0))
+            view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        return view == MAP_FAILED ? nullptr : static_cast<uint8_t*>(view);
+#endif
+    }
+
+    bool SyncSave(uint8_t* data, size_t size, void* handle)
+    {
+#ifdef _WIN32
+        return FlushViewOfFile(data, size) && FlushFileBuffers(static_cast<HANDLE>(handle));
+#else
+        (void)handle;
+        return msync(data, size, MS_SYNC) == 0;
+#endif
+    }
+
+    void UnmapSave(uint8_t* data, size_t size, void* handle)
+    {
+#ifdef _WIN32
+        (void)size;
+        UnmapViewOfFile(data);
+        CloseHandle(static_cast<HANDLE>(handle));
+#else
+        (void)handle;
+        munmap(data, size);
+#endif
+    }
+
+    // Two cartridges writing one file would overwrite each other's saves
+    std::mutex openMutex;
+    std::set<std::string> openPaths;
+}
+
+// The one thread that writes save files, started on the first commit
+class SaveWriter
+{
+public:
+    static SaveWriter& Get()
+    {
+        static SaveWriter writer;
+        return writer;
+    }
+
+    ~SaveWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_one();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void Enqueue(SaveFile* file, std::vector<SaveFile::Page> pages)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!thread.joinable())
+                thread = std::thread(&SaveWriter::Run, this);
+            file->pending++;
+            queue.push_back({ file, std::move(pages) });
+        }
+        wake.notify_one();
+    }
+
+    void Wait(SaveFile* file)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [file] { return file->pending == 0; });
+    }
+
+private:
+    struct Job
+    {
+        SaveFile* file;
+        std::vector<SaveFile::Page> pages;
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::deque<Job> queue;
+    std::thread thread;
+    bool stop = false;
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wake.wait(lock, [this] { return stop || !queue.empty(); });
+            if (queue.empty())
+                return; // stopping, and everything queued is written
+            Job job = std::move(queue.front());
+            queue.pop_front();
+
+            lock.unlock();
+            job.file->Write(job.pages);
+            lock.lock();
+
+            job.file->pending--;
+            done.notify_all();
+        }
+    }
+};
+
+std::unique_ptr<SaveFile> SaveFile::Open(const std::string& path, size_t size)
+{
+    std::unique_ptr<SaveFile> save(new SaveFile());
+    {
+        std::lock_guard<std::mutex> lock(openMutex);
+        if (!openPaths.insert(path).second)
+        {
+            std::cerr << "Save file is already in use, changes will not be saved: " << path << std::endl;
+            return nullptr;
+        }
+    }
+    save->registered = true;
+    save->path = path;
+    save->journalPath = path + ".journal";
+
+    ReplayJournal(save->journalPath, path);
+
+    save->data = MapSave(path, size, save->handle);
+    if (!save->data)
+    {
+        std::cerr << "Failed to open save file: " << path << std::endl;
+        return nullptr;
+    }
+    save->size = size;
+
+    save->journal = std::fopen(save->journalPath.c_str(), "wb");
+    if (!save->journal)
+    {
+        std::cerr << "Failed to create save journal: " << save->journalPath << std::endl;
+        return nullptr;
+    }
+    SyncParentDirectory(save->journalPath);
+    return save;
+}
+
+SaveFile::~SaveFile()
+{
+    Wait();
+    if (data)
+        UnmapSave(data, size, handle);
+    if (journal)
+    {
+        // Everything is on disk, nothing left to replay
+        std::fclose(journal);
+        std::remove(journalPath.c_str());
+    }
+    if (registered)
+    {
+        std::lock_guard<std::mutex> lock(openMutex);
+        openPaths.erase(path);
+    }
+}
+
+void SaveFile::Commit(std::vector<Page> pages)
+{
+    if (!pages.empty())
+        SaveWriter::Get().Enqueue(this, std::move(pages));
+}
+
+void SaveFile::Wait()
+{
+    SaveWriter::Get().Wait(this);
+}
+
+// Journal, apply, sync, retire: a crash at any point leaves either the old
+// contents or a journal that completes the batch
+void SaveFile::Write(const std::vector<Page>& pages)
+{
+    JournalHeader header;
+    std::memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+    header.count = static_cast<uint32_t>(pages.size());
+    header.checksum = Checksum(pages.data(), pages.size());
+
+    std::rewind(journal);
+    const bool journaled = std::fwrite(&header, sizeof(header), 1, journal) == 1 &&
+                           std::fwrite(pages.data(), sizeof(Page), pages.size(), journal) == pages.size() &&
+                           SyncFile(journal);
+    if (!journaled)
+        std::cerr << "Failed to write save journal, saving without it: " << journalPath << std::endl;
+
+    for (const Page& page : pages)
+        if (page.offset + kPageSize <= size)
+            std::memcpy(data + page.offset, page.data, kPageSize);
+    if (!SyncSave(data, size, handle))
+    {
+        std::cerr << "Failed to write save file: " << path << std::endl;
+        return; // keep the journal so the batch is replayed next time
+    }
+
+    // Losing this write only costs a redundant replay
+    const JournalHeader retired = {};
+    std::rewind(journal);
+    std::fwrite(&retired, sizeof(retired), 1, journal);
+    std::fflush(journal);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Persistent store for battery-backed cartridge RAM: the .sav file, mapped
+// read/write. The emulator never writes to the mapping directly; it works on
+// its own copy of the RAM and hands over snapshots of the 256-byte pages that
+// changed. A single background thread shared by all save files applies them,
+// so saving never blocks emulation.
+//
+// Crash safety comes from a write-ahead journal next to the file
+// (<name>.sav.journal): a batch is written to the journal and synced before
+// any of it touches the .sav, and the journal is only cleared once the .sav
+// itself has been synced. A batch interrupted half way is replayed from the
+// journal when the file is next opened, so the .sav always holds either the
+// old or the new contents of a batch, never a mix.
+class SaveFile
+{
+public:
+    static constexpr size_t kPageSize = 0x100;
+
+    struct Page
+    {
+        uint32_t offset; // byte offset in the file, page aligned
+        uint8_t data[kPageSize];
+    };
+
+    // Open or create the file with at least `size` bytes, replaying an
+    // interrupted batch first. nullptr on failure or when another cartridge
+    // in this process already has the file open (reason printed to std::cerr).
+    static std::unique_ptr<SaveFile> Open(const std::string& path, size_t size);
+
+    // Waits for this file's queued batches, then closes it
+    ~SaveFile();
+    SaveFile(const SaveFile&) = delete;
+    SaveFile& operator=(const SaveFile&) = delete;
+
+    // Persisted contents, for the initial load. Only valid before the first
+    // Commit, after that the writer thread owns the mapping.
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+    // Queue a batch of page snapshots; returns immediately
+    void Commit(std::vector<Page> pages);
+
+    // Block until every batch committed so far is on disk
+    void Wait();
+
+private:
+    SaveFile() = default;
+    void Write(const std::vector<Page>& pages); // writer thread
+
+    std::string path;
+    std::string journalPath;
+    std::FILE* journal = nullptr;
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    void* handle = nullptr; // Windows: file handle kept for FlushFileBuffers
+    bool registered = false; // holds `path` in the set of open save files
+    int pending = 0;        // batches queued or being written, guarded by the writer
+
+    friend class SaveWriter;
+};
@@ -0,0 +1,68 @@
+#include "Scheduler.h"
+
+void Scheduler::Reset()
+{
+    for (Event& e : events)
+        e = Event{};
+    now = 0;
+    nextEvent = kNever;
+    breakRequested = false;
+}
+
+void Scheduler::Schedule(EventType type, uint64_t when, Callback callback, void* context)
+{
+    Event& e = events[static_cast<int>(type)];
+    const bool wasNext = (e.when == nextEvent);
+    e.when = when;
+    e.callback = callback;
+    e.context = context;
+    if (when < nextEvent)
+        nextEvent = when;
+    else if (wasNext)
+        UpdateNextEvent();
+}
+
+void Scheduler::Cancel(EventType type)
+{
+    Event& e = events[static_cast<int>(type)];
+    if (e.when == kNever)
+        return;
+    const bool wasNext = (e.when == nextEvent);
+    e.when = kNever;
+    if (wasNext)
+        UpdateNextEvent();
+}
+
+void Scheduler::OnBreak(void* context, uint64_t)
+{
+    static_cast<Scheduler*>(context)->RequestBreak();
+}
+
+void Scheduler::RunDueEvents()
+{
+    // Earliest first; a callback may schedule another event that is already due
+    while (nextEvent <= now)
+    {
+        Event* due = nullptr;
+        for (Event& e : events)
+        {
+            if (e.when <= now && (!due || e.when < due->when))
+                due = &e;
+        }
+
+        const uint64_t when = due->when;
+        due->when = kNever;
+        UpdateNextEvent();
+        due->callback(due->context, when);
+    }
+}
+
+void Scheduler::UpdateNextEvent()
+{
+    nextEvent = kNever;
+    for (const Event& e : events)
+    {
+        if (e.when < nextEvent)
+            nextEvent = e.when;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+
+// Hardware events the core schedules ahead of time. One slot per kind: a
+// device reschedules its own slot from the callback.
+enum class EventType : uint8_t
+{
+    PpuMode,       // end of a PPU mode: OAM scan, drawing, HBlank or a VBlank line
+    TimerOverflow, // TIMA wraps to TMA
+    Break,         // end of the current CPU burst (see CPU::RunUntil)
+    SaveFlush,     // write dirty battery RAM to the .sav file
+    OamDma,        // end of an OAM DMA transfer
+    Count
+};
+
+// Clock for the whole core, in T-cycles. Devices compute their state from
+// Now() on demand and only put the moments they must act on into a slot, so
+// the CPU can jump the clock straight to NextEventTime() when it has nothing
+// to execute (HALT/STOP).
+class Scheduler
+{
+public:
+    // Called with the time the event was due, which may be slightly in the
+    // past; reschedule relative to it to avoid drift
+    using Callback = void (*)(void* context, uint64_t when);
+
+    static constexpr uint64_t kNever = UINT64_MAX;
+
+    void Reset();
+
+    uint64_t Now() const { return now; }
+    uint64_t NextEventTime() const { return nextEvent; }
+
+    void Schedule(EventType type, uint64_t when, Callback callback, void* context);
+    void Cancel(EventType type);
+    bool IsScheduled(EventType type) const { return events[static_cast<int>(type)].when != kNever; }
+
+    // Move the clock forward, running every event that falls due
+    void Advance(uint32_t cycles)
+    {
+        now += cycles;
+        if (now >= nextEvent)
+            RunDueEvents();
+    }
+
+    // Burst control: the CPU runs until a break is requested, either by the
+    // Break event at the burst deadline or by a device that wants the host
+    // to look at its output early
+    void ScheduleBreak(uint64_t when) { breakRequested = false; Schedule(EventType::Break, when, &Scheduler::OnBreak, this); }
+    void RequestBreak() { breakRequested = true; }
+    bool IsBreakRequested() const { return breakRequested; }
+
+    // Translated code advances the clock inline and calls Advance(0) once
+    // NextEventTime() is reached
+    uint64_t* GetNowAddress() { return &now; }
+    const uint64_t* GetNextEventAddress() const { return &nextEvent; }
+
+private:
+    struct Event
+    {
+        uint64_t when = kNever;
+        Callback callback = nullptr;
+        void* context = nullptr;
+    };
+
+    Event events[static_cast<int>(EventType::Count)];
+    uint64_t now = 0;
+    uint64_t nextEvent = kNever;
+    bool breakRequested = false;
+
+    static void OnBreak(void* context, uint64_t when);
+    void RunDueEvents();
+    void UpdateNextEvent();
+};
@@ -0,0 +1,100 @@
+#include "Timers.h"
+#include "Scheduler.h"
+#include "Interrupts.h"
+#include "IORegisters.h"
+
+Timers::Timers(Scheduler& scheduler, Interrupts& interrupts, IORegisters& io) : scheduler(scheduler), interrupts(interrupts)
+{
+    for (uint16_t addr = 0xFF04; addr <= 0xFF07; addr++)
+        io.Register(addr, this,
+            [](void* self, uint16_t addr) { return static_cast<Timers*>(self)->Read(addr); },
+            [](void* self, uint16_t addr, uint8_t value) { static_cast<Timers*>(self)->Write(addr, value); },
+            addr == 0xFF07 ? 0xF8 : 0x00);
+}
+
+void Timers::Reset()
+{
+    counterBase = scheduler.Now();
+    timaTime = counterBase;
+    tima = tma = tac = 0;
+    scheduler.Cancel(EventType::TimerOverflow);
+}
+
+int Timers::PeriodShift() const
+{
+    // 4096, 262144, 65536, 16384 Hz
+    static const int shifts[4] = { 10, 4, 6, 8 };
+    return shifts[tac & 0x03];
+}
+
+uint8_t Timers::Read(uint16_t addr)
+{
+    switch (addr)
+    {
+    case 0xFF04: return static_cast<uint8_t>((scheduler.Now() - counterBase) >> 8);
+    case 0xFF05: Sync(scheduler.Now()); return tima;
+    case 0xFF06: return tma;
+    case 0xFF07: return tac;
+    default: return 0xFF;
+    }
+}
+
+void Timers::Write(uint16_t addr, uint8_t value)
+{
+    const uint64_t now = scheduler.Now();
+    Sync(now);
+    switch (addr)
+    {
+    case 0xFF04: counterBase = now; break; // any write clears the counter
+    case 0xFF05: tima = value; break;
+    case 0xFF06: tma = value; break;
+    case 0xFF07: tac = value & 0x07; break;
+    default: return;
+    }
+    ScheduleOverflow();
+}
+
+// Apply the TIMA increments between the last sync and `now`, reloading from
+// TMA and raising the timer interrupt on every wrap
+void Timers::Sync(uint64_t now)
+{
+    if (Enabled() && now > timaTime)
+    {
+        const int shift = PeriodShift();
+        uint64_t ticks = ((now - counterBase) >> shift) - ((timaTime - counterBase) >> shift);
+        while (ticks > 0)
+        {
+            const uint64_t toWrap = 0x100 - tima;
+            if (ticks < toWrap)
+            {
+                tima = static_cast<uint8_t>(tima + ticks);
+                break;
+            }
+            ticks -= toWrap;
+            tima = tma;
+            interrupts.Request(Interrupts::INT_TIMER);
+        }
+    }
+    timaTime = now;
+}
+
+void Timers::ScheduleOverflow()
+{
+    if (!Enabled())
+    {
+        scheduler.Cancel(EventType::TimerOverflow);
+        return;
+    }
+
+    // The counter edge that takes TIMA from 0xFF to 0x00
+    const int shift = PeriodShift();
+    const uint64_t edge = ((timaTime - counterBase) >> shift) + (0x100 - tima);
+    scheduler.Schedule(EventType::TimerOverflow, counterBase + (edge << shift), &Timers::OnOverflow, this);
+}
+
+void Timers::OnOverflow(void* context, uint64_t when)
+{
+    Timers* timers = static_cast<Timers*>(context);
+    timers->Sync(when);
+    timers->ScheduleOverflow();
+}
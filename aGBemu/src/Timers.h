@@ -1 +1,39 @@
 #pragma once
+#include <cstdint>
+
+class Scheduler;
+class Interrupts;
+class IORegisters;
+
+// DIV/TIMA/TMA/TAC (FF04-FF07). DIV is the high byte of a 16-bit counter
+// running at the CPU clock and TIMA counts edges of one of its bits, so both
+// are derived from the scheduler clock when read instead of being ticked per
+// instruction. Only the TIMA overflow is a scheduled event.
+class Timers
+{
+public:
+    // Claims FF04-FF07
+    Timers(Scheduler& scheduler, Interrupts& interrupts, IORegisters& io);
+
+    void Reset();
+
+    uint8_t Read(uint16_t addr);
+    void Write(uint16_t addr, uint8_t value);
+
+private:
+    Scheduler& scheduler;
+    Interrupts& interrupts;
+
+    uint64_t counterBase = 0; // scheduler time at which the internal counter was 0
+    uint64_t timaTime = 0;    // time TIMA was last brought up to date
+    uint8_t tima = 0;
+    uint8_t tma = 0;
+    uint8_t tac = 0;
+
+    bool Enabled() const { return (tac & 0x04) != 0; }
+    int PeriodShift() const; // TIMA period as a power of two in T-cycles
+
+    void Sync(uint64_t now);
+    void ScheduleOverflow();
+    static void OnOverflow(void* context, uint64_t when);
+};
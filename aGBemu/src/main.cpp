@@ -1,17 +1,16 @@
 #include <SDL3/SDL.h>
 #include "Renderer.h"
-#include "PPU.h"
-#include "MMU.h"
-#include "CPU.h"
+#include "Emulator.h"
 #include <backends/imgui_impl_sdl3.h>
 #include <backends/imgui_impl_opengl3.h>
 #include <iostream>
+#include <memory>
 
 // Helper functions
 SDL_Window* InitSDL();
 Renderer* InitRenderer(SDL_Window* window);
 void Cleanup(SDL_Window* window, Renderer* renderer);
-void MainLoop(SDL_Window* window, Renderer* renderer, CPU& cpu, PPU& ppu, MMU& mmu);
+void MainLoop(SDL_Window* window, Renderer* renderer, Emulator& emulator);
 
 int main(int argc, char** argv)
 {
@@ -26,23 +25,19 @@ int main(int argc, char** argv)
     }
 
     // --- Emulator core initialization ---
-    PPU ppu;
-    MMU mmu(&ppu);
+    // Heap-allocated: the core is tens of KB
+    auto emulator = std::make_unique<Emulator>();
     
     // Optional ROM path from CLI; otherwise load via UI or drag-and-drop
     if (argc >= 2) {
         const char* romPath = argv[1];
-        if (!mmu.LoadROMFromFile(romPath))
+        if (!emulator->LoadRom(romPath))
         {
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load ROM: %s", romPath);
         }
     }
-    CPU cpu(&mmu);
 
-    cpu.Reset();
-    ppu.Reset();
-
-    MainLoop(window, renderer, cpu, ppu, mmu);
+    MainLoop(window, renderer, *emulator);
 
     Cleanup(window, renderer);
     return 0;
@@ -100,14 +95,13 @@ void Cleanup(SDL_Window* window, Renderer* renderer)
 }
 
 // --- Main emulator loop ---
-void MainLoop(SDL_Window* window, Renderer* renderer, CPU& cpu, PPU& ppu, MMU& mmu)
+void MainLoop(SDL_Window* window, Renderer* renderer, Emulator& emulator)
 {
     bool running = true;
     SDL_Event event;
-    bool paused = !mmu.IsROMLoaded();
-    uint32_t lastRomGen = mmu.GetROMLoadGeneration();
+    bool paused = !emulator.IsRomLoaded();
+    uint32_t lastRomGen = emulator.GetRomLoadGeneration();
 
-    const int cyclesPerFrame = 69905; // DMG CPU: ~4.19MHz / 60Hz
     uint64_t lastTime = SDL_GetTicks();
 
     while (running)
@@ -121,7 +115,7 @@ void MainLoop(SDL_Window* window, Renderer* renderer, CPU& cpu, PPU& ppu, MMU& m
             if (event.type == SDL_EVENT_DROP_FILE && event.drop.data)
             {
                 const char* dropped = event.drop.data;
-                if (!mmu.LoadROMFromFile(dropped))
+                if (!emulator.LoadRom(dropped))
                 {
                     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load ROM: %s", dropped);
                 }
@@ -132,33 +126,23 @@ void MainLoop(SDL_Window* window, Renderer* renderer, CPU& cpu, PPU& ppu, MMU& m
             }
         }
 
-        // Detect newly loaded ROM and reset core, unpause
-        uint32_t gen = mmu.GetROMLoadGeneration();
+        // A newly loaded ROM (dropped or from the dialog) unpauses
+        uint32_t gen = emulator.GetRomLoadGeneration();
         if (gen != lastRomGen)
         {
             lastRomGen = gen;
-            cpu.Reset();
-            ppu.Reset();
             paused = false;
         }
 
-        int cyclesThisFrame = 0;
         if (!paused)
         {
-            while (cyclesThisFrame < cyclesPerFrame)
-            {
-                cyclesThisFrame += cpu.Step();
-            }
+            emulator.RunFrame();
         }
 
         // Render
-        if (!paused)
-        {
-            ppu.RenderFrame();
-        }
         renderer->BeginFrame();
-        renderer->RenderGameboyFrame(ppu.GetFramebuffer());
-        renderer->RenderUI(&ppu, &cpu, &mmu, &paused);
+        renderer->RenderGameboyFrame(emulator.GetFramebuffer(), emulator.GetFrameSerial());
+        renderer->RenderUI(&emulator, &paused);
         renderer->EndFrame();
 
         // Frame limiting to ~60Hz